@@ -0,0 +1,217 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "main.h"
+
+// -- ANYTIME SEARCH -- //
+
+// Limits on one AnytimeAStar call: it returns once either runs out.
+struct search_budget
+{
+    std::chrono::steady_clock::time_point deadline = (std::chrono::steady_clock::time_point::max)();
+    std::size_t max_expansions = SIZE_MAX;
+
+    // A budget of time from now.
+    inline static search_budget within(std::chrono::steady_clock::duration time)
+    {
+        search_budget budget;
+        budget.deadline = std::chrono::steady_clock::now() + time;
+        return budget;
+    }
+    inline static search_budget expansions(std::size_t count)
+    {
+        search_budget budget;
+        budget.max_expansions = count;
+        return budget;
+    }
+};
+
+// ARA*-style anytime planning for callers with a hard time budget. The first pass inflates
+// the heuristic by initial_weight, which finds a path after a fraction of the expansions of a
+// plain search, and every later pass lowers the weight by weight_step and improves on it. The
+// passes share one search: every state keeps its cost from earlier passes, a pass only expands
+// states whose cost went down since their bin was last expanded (the open and "inconsistent"
+// states), and the goal state found by one pass seeds the next. A call stops at the budget and
+// the next improve() picks up exactly where it stopped.
+//
+// bound() is the suboptimality bound of the path returned: its cost is at most bound() times
+// the cost of the cheapest path over the search's state lattice. It is the smaller of the
+// pass's weight and the path cost over the cheapest unweighted estimate among the states left
+// to expand, and is 1 once a pass at weight 1 completes.
+class AnytimeAStar
+{
+public:
+    float initial_weight = 3.0f; // heuristic inflation of the first pass
+    float weight_step = 0.5f;    // taken off the weight after every pass, down to 1
+
+    AnytimeAStar(int heading_bins = 32, int offset_bins = 1)
+        : context(heading_bins, offset_bins)
+    {
+        context.reexpand_improved = true;
+    }
+
+    AnytimeAStar(const AnytimeAStar&) = delete;
+    AnytimeAStar& operator=(const AnytimeAStar&) = delete;
+
+    // Starts a new search and runs it within budget. Fills path like AStar::get_path with the
+    // best path found so far; returns false when none has been found yet (or none exists, see
+    // done()). A dubins heuristic must be built for query.radius and outlive the search.
+    template <class Grid>
+    bool plan(const Grid& grid, const Query& query, const search_budget& budget, std::vector<std::size_t>& path, const heuristic& h = heuristic())
+    {
+        session_query = query;
+        session_heuristic = h;
+        context.reset(grid.width, grid.height);
+        current_weight = initial_weight > 1 ? initial_weight : 1;
+        current_bound = INFINITY;
+        best_path.clear();
+        best_cost = INFINITY;
+        pass_count = 0;
+        finished = false;
+        if (!AStar::valid_query(grid, query))
+        {
+            finished = true;
+            path.clear();
+            return false;
+        }
+        state_id start = context.add_start(query.start, query.direction, current_weight * h.estimate(query.start, query.direction, query.goal_x, query.goal_y));
+        std::size_t cell = grid.index(context.cell_x(start), context.cell_y(start));
+        int bin = context.bin(start);
+        context.push(start);
+        context.set_open(cell, bin, start);
+        context.set_best(cell, bin, start);
+        return improve(grid, budget, path);
+    }
+
+    // Continues the last plan() within a new budget. grid must be the map plan() searched,
+    // unchanged since.
+    template <class Grid>
+    bool improve(const Grid& grid, const search_budget& budget, std::vector<std::size_t>& path)
+    {
+        const int goal_x = session_query.goal_x, goal_y = session_query.goal_y;
+        const heuristic& h = session_heuristic;
+        auto estimate = [&](const path_node& n) { return current_weight * h.estimate(n.position, n.direction, goal_x, goal_y); };
+        std::size_t expanded_before = context.expansions;
+        std::size_t pops = 0;
+        bool out_of_budget = false;
+        while (!finished && !out_of_budget)
+        {
+            while (context.frontier.size() > 0 && (context.cell_x(context.frontier.front()) != goal_x || context.cell_y(context.frontier.front()) != goal_y))
+            {
+                // the clock is only read every few pops
+                if (context.expansions - expanded_before >= budget.max_expansions ||
+                    (pops++ % 16 == 0 && std::chrono::steady_clock::now() >= budget.deadline))
+                {
+                    out_of_budget = true;
+                    break;
+                }
+                AStar::expand(grid, context, session_query, estimate);
+            }
+            if (out_of_budget)
+                break;
+            if (context.frontier.size() == 0)
+                finished = true; // nothing left that could lead to the goal
+            else
+                finish_pass(grid);
+        }
+        ASTAR_STAT(context.stats.nodes_expanded = context.expansions; context.stats.peak_frontier = context.peak_frontier;)
+        path = best_path;
+        return !best_path.empty();
+    }
+
+    // Suboptimality bound of the current path, INFINITY while there is none.
+    inline float bound() const
+    {
+        return current_bound;
+    }
+    // Cost of the current path, INFINITY while there is none.
+    inline float cost() const
+    {
+        return best_cost;
+    }
+    // Heuristic weight of the pass in progress (or of the last one, when done).
+    inline float weight() const
+    {
+        return current_weight;
+    }
+    // Passes completed since plan(); each one improved on or confirmed the path.
+    inline int passes() const
+    {
+        return pass_count;
+    }
+    // True when no further improve() can help: the bound reached 1 or the goal is unreachable.
+    inline bool done() const
+    {
+        return finished;
+    }
+    // The search itself; its expansions count covers every pass since plan().
+    inline const SearchContext& search() const
+    {
+        return context;
+    }
+
+private:
+    SearchContext context;
+    Query session_query;
+    heuristic session_heuristic;
+    float current_weight = 1;
+    float current_bound = INFINITY;
+    float best_cost = INFINITY;
+    int pass_count = 0;
+    bool finished = false;
+    std::vector<std::size_t> best_path;
+    std::vector<state_id> carried; // open and inconsistent states between passes
+
+    // Called when a goal state reaches the front of the frontier: records the path if it is
+    // cheaper, works out the bound and starts the next pass with a lower weight.
+    template <class Grid>
+    void finish_pass(const Grid& grid)
+    {
+        const int goal_x = session_query.goal_x, goal_y = session_query.goal_y;
+        const heuristic& h = session_heuristic;
+        state_id goal = context.frontier.front();
+        if (context.g(goal) < best_cost)
+        {
+            AStar::trace_path(grid, context, goal, best_path);
+            best_cost = context.g(goal);
+        }
+        pass_count++;
+
+        carried.clear();
+        context.frontier.for_each([&](state_id n) { carried.push_back(n); });
+        carried.insert(carried.end(), context.inconsistent.begin(), context.inconsistent.end());
+        float lower = best_cost;
+        for (state_id n : carried)
+        {
+            float f = context.g(n) + h.estimate(context.position(n), context.direction(n), goal_x, goal_y);
+            if (f < lower)
+                lower = f;
+        }
+        float ratio = lower > 0 ? best_cost / lower : 1;
+        current_bound = ratio < current_weight ? ratio : current_weight;
+        if (current_bound < 1)
+            current_bound = 1;
+        if (current_weight <= 1 || current_bound <= 1)
+        {
+            current_bound = 1;
+            finished = true;
+            return;
+        }
+
+        float next = current_weight - (weight_step > 0 ? weight_step : current_weight);
+        current_weight = next > 1 ? next : 1;
+        context.restart_pass(grid.width, grid.height);
+        for (state_id n : carried)
+        {
+            std::size_t cell = grid.index(context.cell_x(n), context.cell_y(n));
+            int bin = context.bin(n);
+            if (context.find_best(cell, bin) != n)
+                continue; // a cheaper state in the same bin came later
+            context.set_cost(n, context.g(n) + current_weight * h.estimate(context.position(n), context.direction(n), goal_x, goal_y));
+            context.push(n);
+            context.set_open(cell, bin, n);
+        }
+    }
+};
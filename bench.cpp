@@ -0,0 +1,604 @@
+// Planner benchmark: generates reproducible maps, sweeps turning radii, headings and heuristics,
+// and reports latency percentiles, expansions/sec, peak frontier size and bytes allocated per query.
+//
+// Build: g++ -std=c++20 -O2 -pthread bench.cpp -o bench.exe
+// Usage: bench.exe [--sizes 64,256] [--maps rect,maze,corridor,open] [--radii 2,4,8]
+//                  [--queries 16] [--seed 481] [--threads N] [--csv] [--stats stats.jsonl]
+//                  [--hierarchy] [--bidirectional] [--parallel] [--motions] [--motion-cache dir]
+//                  [--footprint 0.5] [--goals 30] [--cache] [--world 100000]
+// --hierarchy adds rows that route every query through the Planner's cluster hierarchy; its
+// build time per radius is reported on stderr and excluded from the latencies.
+// --bidirectional adds rows that search from both ends with BidirectionalAStar.
+// --parallel adds rows that search each query on all --threads threads with ParallelAStar
+// (HDA*); they have no batch column, since one query already occupies every thread.
+// --motions adds rows that take successors from the Planner's motion table for the radius;
+// its build (or, with --motion-cache, load) time is reported on stderr.
+// --footprint R adds rows for a circular vehicle of radius R, checked along every motion
+// against the Planner's distance field; its build time is reported on stderr.
+// --goals N adds rows where every query asks for paths to N random goals at once
+// (Planner::plan_goals); found counts queries that reached all of them. No batch column.
+// --cache adds rows that repeat every query through the Planner's path cache after one
+// untimed pass has filled it; the hit rate is reported on stderr.
+// --stats writes every timed query's search_stats as one JSON line; the counters are only
+// collected when built with -DASTAR_STATS=1, which also adds their overhead to the latencies.
+// Large maps are opt-in, e.g. --sizes 1024,4096,8192 --maps open.
+// --world N adds "world" rows: an N x N chunked_grid of sparse obstacles, searched directly
+// with AStar, with queries a few hundred cells long as a local planner would issue them.
+#if defined(__GNUC__) && !defined(__clang__)
+// the counting operator new below pairs malloc with free, which GCC cannot see through
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <string>
+#include <sstream>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <fstream>
+#include "main.h"
+#include "planner.h"
+#include "chunked_grid.h"
+#include "parallel.h"
+
+// -- ALLOCATION COUNTING -- //
+
+static std::atomic<std::size_t> allocated_bytes{0};
+static std::atomic<std::size_t> allocation_count{0};
+
+void* operator new(std::size_t size)
+{
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+// -- MAP GENERATION -- //
+
+// Random axis-aligned rectangles built through obstacle, covering roughly 20% of the map.
+void generate_rectangles(occupancy_grid& grid, int size, std::mt19937& rng)
+{
+    std::vector<obstacle> obs;
+    std::uniform_int_distribution<int> position(0, size - 1);
+    std::uniform_int_distribution<int> extent(2, size / 16 + 2);
+    long long covered = 0;
+    while (covered < (long long)size * size / 5)
+    {
+        obstacle o(position(rng), position(rng), extent(rng), extent(rng));
+        covered += (long long)o.width * o.height;
+        obs.push_back(o);
+    }
+    rasterize(grid, obs);
+}
+
+// Perfect maze (recursive backtracker) whose corridors and walls are wide enough to turn in.
+void generate_maze(occupancy_grid& grid, int size, int corridor, std::mt19937& rng)
+{
+    int wall = 1;
+    int pitch = corridor + wall;
+    int cells = (size - wall) / pitch;
+    grid.fill_rect(0, 0, size, size);
+    if (cells < 1)
+        return;
+    std::vector<std::uint8_t> seen(std::size_t(cells) * cells, 0);
+    std::vector<int> stack{0};
+    seen[0] = 1;
+    auto carve = [&](int cx, int cy, int w, int h) {
+        for (int y = cy; y < cy + h; y++)
+            for (int x = cx; x < cx + w; x++)
+                grid.set_blocked(x, y, false);
+    };
+    carve(wall, wall, corridor, corridor);
+    const int dx[4] = {1, -1, 0, 0}, dy[4] = {0, 0, 1, -1};
+    while (!stack.empty())
+    {
+        int current = stack.back();
+        int cx = current % cells, cy = current / cells;
+        int options[4], count = 0;
+        for (int d = 0; d < 4; d++)
+        {
+            int nx = cx + dx[d], ny = cy + dy[d];
+            if (nx >= 0 && nx < cells && ny >= 0 && ny < cells && !seen[std::size_t(ny) * cells + nx])
+                options[count++] = d;
+        }
+        if (count == 0)
+        {
+            stack.pop_back();
+            continue;
+        }
+        int d = options[std::uniform_int_distribution<int>(0, count - 1)(rng)];
+        int nx = cx + dx[d], ny = cy + dy[d];
+        seen[std::size_t(ny) * cells + nx] = 1;
+        // open the wall between the two cells, then the new cell itself
+        int x0 = wall + (dx[d] < 0 ? nx : cx) * pitch, y0 = wall + (dy[d] < 0 ? ny : cy) * pitch;
+        carve(x0, y0, dx[d] != 0 ? pitch + corridor : corridor, dy[d] != 0 ? pitch + corridor : corridor);
+        stack.push_back(ny * cells + nx);
+    }
+}
+
+// Long horizontal walls with randomly placed gaps, forcing repeated S-turns.
+void generate_corridors(occupancy_grid& grid, int size, int corridor, std::mt19937& rng)
+{
+    std::uniform_int_distribution<int> gap_position(0, size - 1);
+    for (int y = corridor; y + 1 < size; y += corridor + 1)
+    {
+        grid.fill_rect(0, y, size, 1);
+        int gaps = 1 + size / 256;
+        for (int i = 0; i < gaps; i++)
+        {
+            int gx = gap_position(rng);
+            for (int x = gx; x < gx + corridor && x < size; x++)
+                grid.set_blocked(x, y, false);
+        }
+    }
+}
+
+// Mostly open terrain with sparse small obstacles (about 2% coverage).
+void generate_open(occupancy_grid& grid, int size, std::mt19937& rng)
+{
+    std::uniform_int_distribution<int> position(0, size - 1);
+    std::uniform_int_distribution<int> extent(1, 3);
+    long long count = (long long)size * size / 200;
+    for (long long i = 0; i < count; i++)
+        grid.fill_rect(position(rng), position(rng), extent(rng), extent(rng));
+}
+
+// Chunked world with a few large obstacles: a tile in five or so ends up mixed, the rest stay
+// single all-free flags.
+void generate_world(chunked_grid& grid, int size, std::mt19937& rng)
+{
+    std::uniform_int_distribution<int> position(0, size - 1);
+    std::uniform_int_distribution<int> extent(4, 48);
+    long long count = (long long)size * size / 40000;
+    for (long long i = 0; i < count; i++)
+        grid.fill_rect(position(rng), position(rng), extent(rng), extent(rng));
+}
+
+// -- QUERY GENERATION -- //
+
+template <class Grid>
+bool random_free_cell(const Grid& grid, std::mt19937& rng, int& x, int& y)
+{
+    std::uniform_int_distribution<int> px(0, grid.width - 1), py(0, grid.height - 1);
+    for (int attempt = 0; attempt < 10000; attempt++)
+    {
+        x = px(rng);
+        y = py(rng);
+        if (!grid.blocked(x, y))
+            return true;
+    }
+    return false;
+}
+
+// Start and goal at least a quarter of the map apart, or with a max_distance, a goal within
+// [max_distance / 2, max_distance] of the start; headings cycle through 8 directions.
+template <class Grid>
+std::vector<Query> generate_queries(const Grid& grid, int count, float radius, heuristic_mode mode, std::mt19937& rng, int max_distance = 0)
+{
+    std::vector<Query> queries;
+    float min_distance = max_distance > 0 ? max_distance / 2.0f : grid.width / 4.0f;
+    std::uniform_int_distribution<int> offset(-max_distance, max_distance);
+    for (int i = 0; i < count * 100 && int(queries.size()) < count; i++)
+    {
+        int sx, sy, gx, gy;
+        if (!random_free_cell(grid, rng, sx, sy) || !random_free_cell(grid, rng, gx, gy))
+            break;
+        if (max_distance > 0)
+        {
+            gx = sx + offset(rng);
+            gy = sy + offset(rng);
+            if (!grid.is_free(gx, gy))
+                continue;
+        }
+        float distance = (vector2d(sx, sy) - vector2d(gx, gy)).magnitude();
+        if (distance < min_distance || (max_distance > 0 && distance > max_distance))
+            continue;
+        float angle = float(queries.size() % 8) * float(M_PI / 4);
+        Query q;
+        q.start = vector2d(sx + 0.5f, sy + 0.5f);
+        q.direction = vector2d(cosf(angle), sinf(angle));
+        q.goal_x = gx;
+        q.goal_y = gy;
+        q.radius = radius;
+        q.heuristic = mode;
+        queries.push_back(q);
+    }
+    return queries;
+}
+
+// -- REPORTING -- //
+
+struct bench_row
+{
+    std::string map;
+    int size = 0;
+    float radius = 0;
+    heuristic_mode mode = heuristic_mode::euclidean;
+    std::string route; // "hpa", "bi", "hda", "mp", "fp", "mg" or "lru" when not a plain AStar search
+    std::size_t queries = 0, found = 0;
+    double p50 = 0, p90 = 0, p99 = 0, max = 0; // milliseconds
+    double expansions_per_query = 0, expansions_per_sec = 0;
+    std::size_t peak_frontier = 0;
+    double bytes_per_query = 0;
+    double batch_queries_per_sec = 0;
+};
+
+double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    std::size_t index = std::size_t(p * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+void print_row(const bench_row& r, bool csv)
+{
+    std::string mode = r.mode == heuristic_mode::dubins ? "dubins" : (r.route.empty() ? "euclidean" : "euclid");
+    if (!r.route.empty())
+        mode += "+" + r.route;
+    if (csv)
+    {
+        std::cout << r.map << ',' << r.size << ',' << r.radius << ',' << mode << ',' << r.queries << ',' << r.found << ','
+                  << r.p50 << ',' << r.p90 << ',' << r.p99 << ',' << r.max << ',' << r.expansions_per_query << ','
+                  << r.expansions_per_sec << ',' << r.peak_frontier << ',' << r.bytes_per_query << ',' << r.batch_queries_per_sec << '\n';
+        return;
+    }
+    std::cout << std::left << std::setw(9) << r.map << std::right << std::setw(6) << r.size << std::setw(6) << r.radius
+              << "  " << std::left << std::setw(10) << mode << std::right
+              << std::setw(4) << r.found << '/' << std::left << std::setw(4) << r.queries << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << r.p50 << std::setw(10) << r.p90 << std::setw(10) << r.p99 << std::setw(10) << r.max
+              << std::setprecision(0) << std::setw(12) << r.expansions_per_query << std::setw(12) << r.expansions_per_sec
+              << std::setw(10) << r.peak_frontier << std::setw(12) << r.bytes_per_query << std::setw(10) << r.batch_queries_per_sec << '\n';
+}
+
+void print_header(bool csv)
+{
+    if (csv)
+    {
+        std::cout << "map,size,radius,heuristic,queries,found,p50_ms,p90_ms,p99_ms,max_ms,expansions_per_query,expansions_per_sec,peak_frontier,bytes_per_query,batch_qps\n";
+        return;
+    }
+    std::cout << "map        size  rad  heuristic  found       p50ms     p90ms     p99ms     maxms    exp/query     exp/sec  frontier   bytes/q batch q/s\n";
+}
+
+// -- CHUNKED WORLDS -- //
+
+// Runs single-threaded AStar queries on a size x size chunked_grid and prints one row per
+// radius and heuristic. Map and closed-set memory go to stderr.
+void run_world(int size, const std::vector<float>& radii, int query_count, unsigned seed, bool csv)
+{
+    std::mt19937 rng(seed + size);
+    chunked_grid world(size, size);
+    auto build_start = std::chrono::steady_clock::now();
+    generate_world(world, size, rng);
+    double build_ms = std::chrono::duration<double>(std::chrono::steady_clock::now() - build_start).count() * 1000;
+    std::cerr << "world " << size << ": built in " << build_ms << " ms, " << world.memory_bytes() << " bytes, "
+              << world.mixed_tiles() << " of " << std::size_t(world.tile_columns) * world.tile_rows << " tiles mixed" << std::endl;
+    SearchContext context;
+    for (float radius : radii)
+    {
+        dubins_table table(radius);
+        for (auto mode : {heuristic_mode::euclidean, heuristic_mode::dubins})
+        {
+            std::mt19937 query_rng(seed + size * 31 + int(radius * 7));
+            auto queries = generate_queries(world, query_count, radius, mode, query_rng, 400);
+            heuristic h = mode == heuristic_mode::dubins ? heuristic(&table) : heuristic();
+            bench_row row;
+            row.map = "world";
+            row.size = size;
+            row.radius = radius;
+            row.mode = mode;
+            row.queries = queries.size();
+            std::vector<std::size_t> path;
+            if (!queries.empty())
+                AStar::get_path(world, context, queries[0], path, h); // warm up the context
+            std::vector<double> latencies;
+            std::size_t total_expansions = 0;
+            double total_seconds = 0;
+            std::size_t bytes_before = allocated_bytes.load();
+            for (const auto& query : queries)
+            {
+                auto start = std::chrono::steady_clock::now();
+                row.found += AStar::get_path(world, context, query, path, h);
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                latencies.push_back(seconds * 1000);
+                total_seconds += seconds;
+                total_expansions += context.expansions;
+                row.peak_frontier = std::max(row.peak_frontier, context.peak_frontier);
+            }
+            if (!queries.empty())
+            {
+                row.bytes_per_query = double(allocated_bytes.load() - bytes_before) / queries.size();
+                row.expansions_per_query = double(total_expansions) / queries.size();
+            }
+            row.p50 = percentile(latencies, 0.50);
+            row.p90 = percentile(latencies, 0.90);
+            row.p99 = percentile(latencies, 0.99);
+            row.max = percentile(latencies, 1.0);
+            row.expansions_per_sec = total_seconds > 0 ? total_expansions / total_seconds : 0;
+            print_row(row, csv);
+        }
+    }
+    std::cerr << "world " << size << ": search context " << context.memory_bytes() << " bytes" << std::endl;
+}
+
+// -- ARGUMENTS -- //
+
+template <class T>
+std::vector<T> parse_list(const std::string& text)
+{
+    std::vector<T> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        std::stringstream value(item);
+        T v;
+        if (value >> v)
+            values.push_back(v);
+    }
+    return values;
+}
+
+// -- MAIN FUNCTION -- //
+
+int main(int argc, char** argv)
+{
+    std::vector<int> sizes{64, 256};
+    std::vector<std::string> maps{"rect", "maze", "corridor", "open"};
+    std::vector<float> radii{2, 4, 8};
+    int query_count = 16;
+    unsigned seed = 481;
+    unsigned threads = std::thread::hardware_concurrency();
+    bool csv = false;
+    bool hierarchy = false;
+    bool bidirectional_rows = false;
+    bool parallel_rows = false;
+    bool motion_rows = false;
+    std::string motion_cache;
+    float footprint_radius = 0;
+    int goal_count = 0;
+    bool cache_rows = false;
+    std::vector<int> worlds;
+    std::ofstream stats_file;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        std::string value = i + 1 < argc ? argv[i + 1] : "";
+        if (arg == "--sizes") { sizes = parse_list<int>(value); i++; }
+        else if (arg == "--maps") { maps = parse_list<std::string>(value); i++; }
+        else if (arg == "--radii") { radii = parse_list<float>(value); i++; }
+        else if (arg == "--queries") { query_count = std::atoi(value.c_str()); i++; }
+        else if (arg == "--seed") { seed = unsigned(std::atoi(value.c_str())); i++; }
+        else if (arg == "--threads") { threads = unsigned(std::atoi(value.c_str())); i++; }
+        else if (arg == "--csv") { csv = true; }
+        else if (arg == "--hierarchy") { hierarchy = true; }
+        else if (arg == "--bidirectional") { bidirectional_rows = true; }
+        else if (arg == "--parallel") { parallel_rows = true; }
+        else if (arg == "--motions") { motion_rows = true; }
+        else if (arg == "--motion-cache") { motion_cache = value; i++; }
+        else if (arg == "--footprint") { footprint_radius = float(std::atof(value.c_str())); i++; }
+        else if (arg == "--goals") { goal_count = std::atoi(value.c_str()); i++; }
+        else if (arg == "--cache") { cache_rows = true; }
+        else if (arg == "--world") { worlds = parse_list<int>(value); i++; }
+        else if (arg == "--stats")
+        {
+            stats_file.open(value);
+            i++;
+            if (!ASTAR_STATS)
+                std::cerr << "warning: built without ASTAR_STATS, search counters will be zero" << std::endl;
+        }
+        else
+        {
+            std::cerr << "unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    enum class route { direct, hierarchical, bidirectional, parallel, motions, footprint, goals, cached };
+    std::vector<std::pair<heuristic_mode, route>> variants;
+    for (route how : {route::direct, route::hierarchical, route::bidirectional, route::parallel, route::motions, route::footprint, route::goals, route::cached})
+        if (how == route::direct || (how == route::hierarchical && hierarchy) || (how == route::bidirectional && bidirectional_rows) ||
+            (how == route::parallel && parallel_rows) || (how == route::motions && motion_rows) || (how == route::footprint && footprint_radius > 0) ||
+            (how == route::goals && goal_count > 0) || (how == route::cached && cache_rows))
+            for (auto mode : {heuristic_mode::euclidean, heuristic_mode::dubins})
+                variants.push_back({mode, how});
+
+    print_header(csv);
+    for (const auto& map_name : maps)
+    {
+        for (int size : sizes)
+        {
+            std::mt19937 rng(seed + size);
+            auto grid = std::make_shared<occupancy_grid>(size, size);
+            int corridor = int(2 * radii.back()) + 2;
+            if (map_name == "rect") generate_rectangles(*grid, size, rng);
+            else if (map_name == "maze") generate_maze(*grid, size, corridor, rng);
+            else if (map_name == "corridor") generate_corridors(*grid, size, corridor, rng);
+            else if (map_name == "open") generate_open(*grid, size, rng);
+            else
+            {
+                std::cerr << "unknown map type " << map_name << std::endl;
+                return 1;
+            }
+            Planner planner(grid, threads);
+            planner.motion_cache = motion_cache;
+            SearchContext context, backward;
+            std::unique_ptr<ParallelAStar> hda(parallel_rows ? new ParallelAStar(threads) : nullptr);
+            for (float radius : radii)
+            {
+                for (auto [mode, how] : variants)
+                {
+                    bool hierarchical = how == route::hierarchical;
+                    bool bidirectional = how == route::bidirectional;
+                    bool parallel = how == route::parallel;
+                    bool motions = how == route::motions;
+                    bool with_footprint = how == route::footprint;
+                    bool multi_goal = how == route::goals;
+                    bool cached = how == route::cached;
+                    std::mt19937 query_rng(seed + size * 31 + int(radius * 7));
+                    auto queries = generate_queries(*grid, query_count, radius, mode, query_rng);
+                    for (auto& query : queries)
+                    {
+                        query.hierarchical = hierarchical;
+                        query.bidirectional = bidirectional;
+                    }
+                    bench_row row;
+                    row.map = map_name;
+                    row.size = size;
+                    row.radius = radius;
+                    row.mode = mode;
+                    row.route = hierarchical ? "hpa" : bidirectional ? "bi" : parallel ? "hda" : motions ? "mp" : with_footprint ? "fp" : multi_goal ? "mg" : cached ? "lru" : "";
+                    row.queries = queries.size();
+                    if (queries.empty())
+                    {
+                        print_row(row, csv);
+                        continue;
+                    }
+                    if (hierarchical && mode == heuristic_mode::euclidean)
+                    {
+                        auto build_start = std::chrono::steady_clock::now();
+                        const ClusterHierarchy& built = planner.hierarchy(radius);
+                        double build_ms = std::chrono::duration<double>(std::chrono::steady_clock::now() - build_start).count() * 1000;
+                        std::cerr << "hierarchy " << map_name << ' ' << size << " radius " << radius << ": built in " << build_ms
+                                  << " ms, " << built.memory_bytes() << " bytes" << std::endl;
+                    }
+                    if (motions)
+                    {
+                        auto build_start = std::chrono::steady_clock::now();
+                        const motion_table& table = planner.motions(radius);
+                        double build_ms = std::chrono::duration<double>(std::chrono::steady_clock::now() - build_start).count() * 1000;
+                        if (mode == heuristic_mode::euclidean)
+                            std::cerr << "motion table radius " << radius << ": " << (motion_cache.empty() ? "built" : "loaded or built") << " in "
+                                      << build_ms << " ms, " << table.memory_bytes() << " bytes" << std::endl;
+                        for (auto& query : queries)
+                            query.motions = &table;
+                    }
+                    collision_checker vehicle;
+                    if (with_footprint)
+                    {
+                        auto build_start = std::chrono::steady_clock::now();
+                        vehicle = collision_checker(planner.clearance(), footprint::circle(footprint_radius));
+                        double build_ms = std::chrono::duration<double>(std::chrono::steady_clock::now() - build_start).count() * 1000;
+                        if (mode == heuristic_mode::euclidean && radius == radii.front())
+                            std::cerr << "distance field " << map_name << ' ' << size << ": built in " << build_ms << " ms, "
+                                      << vehicle.field->memory_bytes() << " bytes" << std::endl;
+                        for (auto& query : queries)
+                            query.collision = &vehicle;
+                    }
+                    std::vector<goal_path> goals(multi_goal ? goal_count : 0);
+                    std::mt19937 goal_rng(seed + size * 17 + int(radius * 5));
+                    QueryResult result;
+                    auto plan = [&](const Query& query)
+                    {
+                        if (multi_goal)
+                        {
+                            for (auto& goal : goals)
+                                random_free_cell(*grid, goal_rng, goal.goal_x, goal.goal_y);
+                            result.found = planner.plan_goals(query, goals, context) == goals.size();
+                            result.cost = 0;
+                            for (const auto& goal : goals)
+                                result.cost += goal.cost;
+                            result.expansions = context.expansions;
+                            result.peak_frontier = context.peak_frontier;
+                            result.stats = context.stats;
+                            return;
+                        }
+                        if (!parallel)
+                        {
+                            planner.plan(query, result, context, &backward);
+                            return;
+                        }
+                        heuristic h = query.heuristic == heuristic_mode::dubins ? heuristic(&planner.dubins(query.radius)) : heuristic();
+                        result.found = hda->get_path(*grid, context, query, result.path, h);
+                        result.cost = context.path_cost;
+                        result.expansions = context.expansions;
+                        result.peak_frontier = context.peak_frontier;
+                        result.stats = context.stats;
+                    };
+                    // warm up the context and the Dubins table so steady-state allocations are measured
+                    plan(queries[0]);
+                    if (cached)
+                    {
+                        planner.results.reset(new path_cache());
+                        for (const auto& query : queries)
+                            plan(query);
+                        planner.results->reset_stats();
+                    }
+
+                    std::vector<double> latencies;
+                    std::size_t total_expansions = 0;
+                    double total_seconds = 0;
+                    std::size_t bytes_before = allocated_bytes.load();
+                    for (const auto& query : queries)
+                    {
+                        auto start = std::chrono::steady_clock::now();
+                        plan(query);
+                        auto end = std::chrono::steady_clock::now();
+                        double seconds = std::chrono::duration<double>(end - start).count();
+                        latencies.push_back(seconds * 1000);
+                        total_seconds += seconds;
+                        total_expansions += result.expansions;
+                        row.found += result.found;
+                        row.peak_frontier = std::max(row.peak_frontier, result.peak_frontier);
+                        if (stats_file.is_open())
+                        {
+                            std::string fields = "\"map\":" + json_string(map_name) + ",\"size\":" + std::to_string(size) +
+                                                 ",\"radius\":" + std::to_string(radius) + ",\"heuristic\":" +
+                                                 json_string(mode == heuristic_mode::dubins ? "dubins" : "euclidean") + ",\"hierarchical\":" +
+                                                 (hierarchical ? "true" : "false") + ",\"bidirectional\":" +
+                                                 (bidirectional ? "true" : "false") + ",\"parallel\":" +
+                                                 (parallel ? "true" : "false") + ",\"motions\":" +
+                                                 (motions ? "true" : "false") + ",\"footprint\":" +
+                                                 (with_footprint ? "true" : "false") + ",\"goals\":" +
+                                                 std::to_string(multi_goal ? goal_count : 1) + ",\"cached\":" +
+                                                 (cached ? "true" : "false") + ",\"latency_ms\":" +
+                                                 std::to_string(seconds * 1000) + ",";
+                            write_json_line(stats_file, result.stats, result.found, result.cost, fields.c_str());
+                        }
+                    }
+                    row.bytes_per_query = double(allocated_bytes.load() - bytes_before) / queries.size();
+                    row.p50 = percentile(latencies, 0.50);
+                    row.p90 = percentile(latencies, 0.90);
+                    row.p99 = percentile(latencies, 0.99);
+                    row.max = percentile(latencies, 1.0);
+                    row.expansions_per_query = double(total_expansions) / queries.size();
+                    row.expansions_per_sec = total_seconds > 0 ? total_expansions / total_seconds : 0;
+
+                    if (!parallel && !multi_goal)
+                    {
+                        std::vector<QueryResult> results(queries.size());
+                        auto start = std::chrono::steady_clock::now();
+                        planner.plan_batch(queries, results);
+                        double batch_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                        row.batch_queries_per_sec = batch_seconds > 0 ? queries.size() / batch_seconds : 0;
+                    }
+                    if (cached)
+                    {
+                        path_cache_stats cache_stats = planner.results->stats();
+                        std::cerr << "path cache " << map_name << ' ' << size << " radius " << radius << ": " << cache_stats.hits << " hits, "
+                                  << cache_stats.misses << " misses, hit rate " << cache_stats.hit_rate() << std::endl;
+                        planner.results.reset();
+                    }
+                    print_row(row, csv);
+                }
+            }
+        }
+    }
+    for (int size : worlds)
+        run_world(size, radii, query_count, seed, csv);
+    return 0;
+}
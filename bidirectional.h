@@ -0,0 +1,114 @@
+#pragma once
+#include <vector>
+#include "main.h"
+
+// -- BIDIRECTIONAL SEARCH -- //
+
+// Runs A* forward from the start pose and backward from the goal cell at the same time. A
+// forward-only car driving an arc or a straight line backward in time is a car with the
+// opposite heading driving the mirrored arc forward, so the backward search is the ordinary
+// expansion on reversed headings: a backward state (p, d) stands for the pose (p, -d). The
+// goal heading is free, so the backward search starts from one state per heading bin at the
+// goal cell's centre.
+//
+// The searches meet when one expands a state in a cell where the other has expanded a state
+// of the same (real) heading bin. The joined path is exact on either side of the meeting cell
+// and, like the lattice's closed set, treats the two states as the same pose inside it. Each
+// step expands the side with the smaller frontier, and the search stops at the first meeting:
+// waiting until no cheaper meeting is possible costs more expansions than a one-way search,
+// while the first meeting is rarely more than 1% longer than the one-way path.
+class BidirectionalAStar
+{
+public:
+    // Same contract as AStar::get_path; backward is a second context for the goal side. The
+    // heuristic is used in both directions (the backward side aims at the start cell).
+    template <class Grid>
+    inline static bool get_path(const Grid& grid, SearchContext& forward, SearchContext& backward, const Query& query, std::vector<std::size_t>& path, const heuristic& h = heuristic())
+    {
+        const int goal_x = query.goal_x, goal_y = query.goal_y;
+        const int start_x = int(query.start.x), start_y = int(query.start.y);
+        forward.reset(grid.width, grid.height);
+        backward.reset(grid.width, grid.height);
+        path.clear();
+        if (!AStar::valid_query(grid, query))
+            return false;
+
+        forward.push(forward.add_start(query.start, query.direction, h.estimate(query.start, query.direction, goal_x, goal_y)));
+        const vector2d goal_center(goal_x + 0.5f, goal_y + 0.5f);
+        for (int b = 0; b < backward.closed.heading_bins; b++)
+        {
+            vector2d reversed = backward.closed.heading_direction(b) * -1.0f;
+            backward.push(backward.add_start(goal_center, reversed, h.estimate(goal_center, reversed, start_x, start_y)));
+        }
+
+        auto forward_estimate = [&](const path_node& n) { return h.estimate(n.position, n.direction, goal_x, goal_y); };
+        auto backward_estimate = [&](const path_node& n) { return h.estimate(n.position, n.direction, start_x, start_y); };
+        float best = INFINITY;
+        state_id best_forward = no_state;
+        state_id best_backward = no_state; // none when the forward side reached the goal cell itself
+        while (best_forward == no_state && forward.frontier.size() > 0 && backward.frontier.size() > 0)
+        {
+            state_id forward_front = forward.frontier.front();
+            if (forward.cell_x(forward_front) == goal_x && forward.cell_y(forward_front) == goal_y)
+            {
+                // reaching the goal cell is a meeting with the backward seeds
+                best = forward.g(forward_front);
+                best_forward = forward_front;
+                break;
+            }
+            bool forward_turn = forward.frontier.size() <= backward.frontier.size();
+            SearchContext& side = forward_turn ? forward : backward;
+            SearchContext& other = forward_turn ? backward : forward;
+            state_id front = side.frontier.front();
+            std::size_t expansions = side.expansions;
+            if (forward_turn)
+                AStar::expand(grid, forward, query, forward_estimate);
+            else
+                AStar::expand(grid, backward, query, backward_estimate);
+            if (side.expansions == expansions)
+                continue; // its bin was already expanded
+            std::size_t cell = grid.index(side.cell_x(front), side.cell_y(front));
+            vector2d direction = side.direction(front);
+            int heading = side.closed.heading_bin(forward_turn ? direction : direction * -1.0f);
+            std::uint64_t key = std::uint64_t(cell) * side.closed.heading_bins + heading;
+            state_id match = other.expanded_states.find(key);
+            if (match != no_state)
+            {
+                best = side.g(front) + other.g(match) + (side.position(front) - other.position(match)).magnitude();
+                best_forward = forward_turn ? front : match;
+                best_backward = forward_turn ? match : front;
+                break;
+            }
+            state_id seen = side.expanded_states.find(key);
+            if (seen == no_state || side.g(seen) > side.g(front))
+                side.expanded_states.insert(key, front);
+        }
+        forward.expansions += backward.expansions;
+        if (backward.peak_frontier > forward.peak_frontier)
+            forward.peak_frontier = backward.peak_frontier;
+        ASTAR_STAT(forward.stats.add(backward.stats); forward.stats.nodes_expanded = forward.expansions; forward.stats.peak_frontier = forward.peak_frontier;)
+        if (best_forward == no_state)
+            return false;
+
+        // cells from the goal to the meeting cell, then the forward chain back to the start
+        vector2d goal_position = forward.position(best_forward);
+        vector2d goal_direction = forward.direction(best_forward);
+        if (best_backward != no_state)
+        {
+            for (state_id step = best_backward; step != no_state; step = backward.previous(step))
+            {
+                path.push_back(grid.index(backward.cell_x(step), backward.cell_y(step)));
+                goal_position = backward.position(step);
+                goal_direction = backward.direction(step) * -1.0f;
+            }
+            std::reverse(path.begin(), path.end());
+            path.pop_back(); // the meeting cell comes again with the forward chain
+        }
+        for (state_id step = best_forward; step != no_state; step = forward.previous(step))
+            path.push_back(grid.index(forward.cell_x(step), forward.cell_y(step)));
+        forward.path_cost = best;
+        forward.path_position = goal_position;
+        forward.path_direction = goal_direction;
+        return true;
+    }
+};
@@ -0,0 +1,218 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "occupancy_grid.h"
+
+// Sparse occupancy map for very large, mostly uniform worlds. The map is cut into 64 x 64
+// tiles; a tile that is entirely free or entirely blocked is a single flag, and only mixed
+// tiles own 64 words of bits (one word per row, bit x & 63 of word y & 63). A 100k x 100k map
+// that is mostly open costs a few bytes per tile instead of 1.25 GB of dense bits. It has
+// the same cell-index and occupancy API as occupancy_grid, so AStar searches it directly.
+class chunked_grid
+{
+public:
+    static constexpr int tile_shift = 6;
+    static constexpr int tile_size = 1 << tile_shift;
+
+    int width = 0, height = 0;
+    int tile_columns = 0, tile_rows = 0;
+    std::uint64_t version = 0; // bumped by every edit, like occupancy_grid::version
+
+    chunked_grid() {}
+    chunked_grid(int w, int h) { resize(w, h); }
+
+    // Resizes to w x h free cells.
+    void resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        tile_columns = (w + tile_size - 1) >> tile_shift;
+        tile_rows = (h + tile_size - 1) >> tile_shift;
+        tiles.assign(std::size_t(tile_columns) * std::size_t(tile_rows), all_free);
+        blocks.clear();
+        spare.clear();
+        version++;
+    }
+
+    // cell index API
+
+    inline bool in_bounds(int x, int y) const
+    {
+        return x >= 0 && x < width && y >= 0 && y < height;
+    }
+    inline std::size_t index(int x, int y) const
+    {
+        return std::size_t(y) * std::size_t(width) + std::size_t(x);
+    }
+    inline int cell_x(std::size_t cell) const
+    {
+        return int(cell % std::size_t(width));
+    }
+    inline int cell_y(std::size_t cell) const
+    {
+        return int(cell / std::size_t(width));
+    }
+    inline std::size_t cell_count() const
+    {
+        return std::size_t(width) * std::size_t(height);
+    }
+
+    // occupancy
+
+    inline bool blocked(int x, int y) const
+    {
+        std::uint32_t tile = tiles[tile_index(x, y)];
+        if (tile <= all_blocked)
+            return tile == all_blocked;
+        return (blocks[std::size_t(tile - first_block) * tile_size + (y & (tile_size - 1))] >> (x & (tile_size - 1))) & 1;
+    }
+    inline bool is_free(int x, int y) const
+    {
+        return in_bounds(x, y) && !blocked(x, y);
+    }
+    void set_blocked(int x, int y, bool value)
+    {
+        std::size_t t = tile_index(x, y);
+        if (tiles[t] == (value ? all_blocked : all_free))
+            return;
+        std::uint64_t& word = tile_rows_of(t)[y & (tile_size - 1)];
+        std::uint64_t mask = std::uint64_t(1) << (x & (tile_size - 1));
+        word = value ? (word | mask) : (word & ~mask);
+        version++;
+    }
+
+    // Marks the rectangle [x, x + w) x [y, y + h) as blocked, clipped to the map. Tiles the
+    // rectangle covers completely become single all-blocked flags.
+    void fill_rect(int x, int y, int w, int h)
+    {
+        int x0 = x < 0 ? 0 : x;
+        int y0 = y < 0 ? 0 : y;
+        int x1 = x + w > width ? width : x + w;
+        int y1 = y + h > height ? height : y + h;
+        if (x0 >= x1 || y0 >= y1)
+            return;
+        version++;
+        for (int ty = y0 >> tile_shift; ty <= (y1 - 1) >> tile_shift; ty++)
+        {
+            for (int tx = x0 >> tile_shift; tx <= (x1 - 1) >> tile_shift; tx++)
+            {
+                std::size_t t = std::size_t(ty) * tile_columns + tx;
+                if (tiles[t] == all_blocked)
+                    continue;
+                // the part of the rectangle inside this tile, in tile-local coordinates
+                int lx0 = x0 > tx * tile_size ? x0 - tx * tile_size : 0;
+                int ly0 = y0 > ty * tile_size ? y0 - ty * tile_size : 0;
+                int lx1 = x1 < (tx + 1) * tile_size ? x1 - tx * tile_size : tile_size;
+                int ly1 = y1 < (ty + 1) * tile_size ? y1 - ty * tile_size : tile_size;
+                if (covers_tile(tx, ty, lx0, ly0, lx1, ly1))
+                {
+                    release(t);
+                    tiles[t] = all_blocked;
+                    continue;
+                }
+                std::uint64_t mask = (lx1 - lx0 == 64 ? ~std::uint64_t(0) : ((std::uint64_t(1) << (lx1 - lx0)) - 1)) << lx0;
+                std::uint64_t* rows = tile_rows_of(t);
+                for (int ly = ly0; ly < ly1; ly++)
+                    rows[ly] |= mask;
+            }
+        }
+    }
+
+    // Turns mixed tiles that ended up uniform back into flags, e.g. after a bulk import.
+    void compact()
+    {
+        for (std::size_t t = 0; t < tiles.size(); t++)
+        {
+            if (tiles[t] < first_block)
+                continue;
+            int tx = int(t % tile_columns), ty = int(t / tile_columns);
+            const std::uint64_t* rows = &blocks[std::size_t(tiles[t] - first_block) * tile_size];
+            int lx1 = width - tx * tile_size < tile_size ? width - tx * tile_size : tile_size;
+            int ly1 = height - ty * tile_size < tile_size ? height - ty * tile_size : tile_size;
+            std::uint64_t mask = lx1 == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << lx1) - 1;
+            bool any = false, all = true;
+            for (int ly = 0; ly < ly1; ly++)
+            {
+                any = any || (rows[ly] & mask) != 0;
+                all = all && (rows[ly] & mask) == mask;
+            }
+            if (any && !all)
+                continue;
+            release(t);
+            tiles[t] = all ? all_blocked : all_free;
+        }
+    }
+
+    // Copies a dense grid, storing uniform tiles as flags.
+    void assign(const occupancy_grid& grid)
+    {
+        resize(grid.width, grid.height);
+        for (int y = 0; y < height; y++)
+        {
+            const std::uint64_t* row = grid.row_data(y);
+            for (int tx = 0; tx < tile_columns; tx++)
+                if (row[tx] != 0)
+                    tile_rows_of(std::size_t(y >> tile_shift) * tile_columns + tx)[y & (tile_size - 1)] = row[tx];
+        }
+        compact();
+    }
+
+    inline std::size_t mixed_tiles() const
+    {
+        return blocks.size() / tile_size - spare.size();
+    }
+    inline std::size_t memory_bytes() const
+    {
+        return tiles.capacity() * sizeof(std::uint32_t) + blocks.capacity() * sizeof(std::uint64_t) + spare.capacity() * sizeof(std::uint32_t);
+    }
+
+private:
+    static constexpr std::uint32_t all_free = 0;
+    static constexpr std::uint32_t all_blocked = 1;
+    static constexpr std::uint32_t first_block = 2; // tiles[t] - first_block indexes blocks
+
+    std::vector<std::uint32_t> tiles;   // all_free, all_blocked or a block number
+    std::vector<std::uint64_t> blocks;  // tile_size words per mixed tile
+    std::vector<std::uint32_t> spare;   // released block numbers
+
+    inline std::size_t tile_index(int x, int y) const
+    {
+        return std::size_t(y >> tile_shift) * std::size_t(tile_columns) + std::size_t(x >> tile_shift);
+    }
+    // true when the local rectangle covers every in-map cell of tile (tx, ty)
+    inline bool covers_tile(int tx, int ty, int lx0, int ly0, int lx1, int ly1) const
+    {
+        int full_x = width - tx * tile_size < tile_size ? width - tx * tile_size : tile_size;
+        int full_y = height - ty * tile_size < tile_size ? height - ty * tile_size : tile_size;
+        return lx0 == 0 && ly0 == 0 && lx1 >= full_x && ly1 >= full_y;
+    }
+    // Rows of tile t, materializing a block from its flag when needed.
+    std::uint64_t* tile_rows_of(std::size_t t)
+    {
+        if (tiles[t] < first_block)
+        {
+            std::uint64_t fill = tiles[t] == all_blocked ? ~std::uint64_t(0) : 0;
+            std::uint32_t block;
+            if (!spare.empty())
+            {
+                block = spare.back();
+                spare.pop_back();
+            }
+            else
+            {
+                block = std::uint32_t(blocks.size() / tile_size);
+                blocks.resize(blocks.size() + tile_size);
+            }
+            for (int i = 0; i < tile_size; i++)
+                blocks[std::size_t(block) * tile_size + i] = fill;
+            tiles[t] = block + first_block;
+        }
+        return &blocks[std::size_t(tiles[t] - first_block) * tile_size];
+    }
+    inline void release(std::size_t t)
+    {
+        if (tiles[t] >= first_block)
+            spare.push_back(tiles[t] - first_block);
+    }
+};
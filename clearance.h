@@ -0,0 +1,317 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <math.h>
+#include "geometry.h"
+
+// -- DISTANCE FIELD -- //
+
+// Euclidean distance transform of an occupancy map: for every point of a lattice with
+// resolution samples per cell, the exact distance to the nearest blocked cell (as a solid
+// square) or to the map border. Blocked squares have their corners on the lattice, so the
+// nearest obstacle point to a lattice point is itself a lattice point and the transform is the
+// classic two-pass squared distance transform (Felzenszwalb and Huttenlocher) over seed samples:
+// columns first, then rows, each pass split over threads. Distances are 1-Lipschitz, so
+// clearance() turns the samples around any point into a lower bound on its distance in O(1).
+class distance_field
+{
+public:
+    int width = 0, height = 0; // map size in cells
+    int resolution = 2;        // samples per cell edge
+    int columns = 0, rows = 0; // samples per row and per column, width * resolution + 1 etc.
+    std::uint64_t version = 0; // the map's version when built
+
+    distance_field() {}
+    template <class Grid>
+    distance_field(const Grid& grid, int samples_per_cell = 2, unsigned threads = std::thread::hardware_concurrency())
+    {
+        build(grid, samples_per_cell, threads);
+    }
+
+    // Recomputes the field for grid, threads lines at a time. Grid is an occupancy_grid or
+    // chunked_grid; the field is dense either way, 4 * columns * rows bytes.
+    template <class Grid>
+    void build(const Grid& grid, int samples_per_cell = 2, unsigned threads = std::thread::hardware_concurrency())
+    {
+        width = grid.width;
+        height = grid.height;
+        resolution = samples_per_cell < 1 ? 1 : samples_per_cell;
+        columns = width * resolution + 1;
+        rows = height * resolution + 1;
+        version = grid.version;
+        samples.assign(std::size_t(columns) * rows, 0);
+
+        // columns: squared distance to the nearest seed in the same column (the border rows
+        // are seeds, so there always is one)
+        for_each_line(columns, threads, [&](int i, line_buffers&)
+        {
+            int last = 0;
+            for (int j = 0; j < rows; j++)
+            {
+                if (seed(grid, i, j))
+                    last = j;
+                at(i, j) = float(j - last);
+            }
+            last = rows - 1;
+            for (int j = rows - 1; j >= 0; j--)
+            {
+                if (at(i, j) == 0)
+                    last = j;
+                float d = std::min(at(i, j), float(last - j));
+                at(i, j) = d * d;
+            }
+        });
+        // rows: lower envelope of the column distances' parabolas, then back to cells
+        for_each_line(rows, threads, [&](int j, line_buffers& buffers)
+        {
+            float* row = &at(0, j);
+            squared_transform(row, columns, buffers);
+            for (int i = 0; i < columns; i++)
+                row[i] = sqrtf(row[i]) / float(resolution);
+        });
+    }
+
+    // Lower bound on the distance from position to the nearest obstacle or the map border,
+    // short of the exact value by at most sqrt(2) / resolution cells; 0 outside the map.
+    inline float clearance(const vector2d& position) const
+    {
+        float gx = position.x * resolution, gy = position.y * resolution;
+        if (!(gx >= 0 && gy >= 0 && gx <= float(columns - 1) && gy <= float(rows - 1)))
+            return 0;
+        int i = std::min(int(gx), columns - 2), j = std::min(int(gy), rows - 2);
+        float fx = gx - float(i), fy = gy - float(j);
+        const float* row = &samples[std::size_t(j) * columns + i];
+        float scale = 1.0f / float(resolution);
+        float best = row[0] - sqrtf(fx * fx + fy * fy) * scale;
+        best = std::max(best, row[1] - sqrtf((1 - fx) * (1 - fx) + fy * fy) * scale);
+        best = std::max(best, row[columns] - sqrtf(fx * fx + (1 - fy) * (1 - fy)) * scale);
+        best = std::max(best, row[columns + 1] - sqrtf((1 - fx) * (1 - fx) + (1 - fy) * (1 - fy)) * scale);
+        return best;
+    }
+
+    // Exact distance at lattice point (i, j), the point (i, j) / resolution.
+    inline float sample(int i, int j) const
+    {
+        return samples[std::size_t(j) * columns + i];
+    }
+
+    inline std::size_t memory_bytes() const
+    {
+        return samples.capacity() * sizeof(float);
+    }
+
+private:
+    std::vector<float> samples; // row-major, columns per row
+
+    struct line_buffers
+    {
+        std::vector<double> f, z; // line values, envelope boundaries
+        std::vector<int> v;       // envelope parabolas
+    };
+
+    inline float& at(int i, int j)
+    {
+        return samples[std::size_t(j) * columns + i];
+    }
+
+    // A lattice point is a seed when it lies on the map border or on a blocked square,
+    // i.e. in one of the (up to four) cells it touches.
+    template <class Grid>
+    inline bool seed(const Grid& grid, int i, int j) const
+    {
+        if (i == 0 || j == 0 || i == columns - 1 || j == rows - 1)
+            return true;
+        int x = i / resolution, y = j / resolution;
+        bool left = i % resolution == 0, up = j % resolution == 0;
+        return grid.blocked(x, y) || (left && grid.blocked(x - 1, y)) || (up && grid.blocked(x, y - 1)) || (left && up && grid.blocked(x - 1, y - 1));
+    }
+
+    // Runs line(index, buffers) for index in [0, count), spread over threads workers in
+    // blocks of 64 lines; each worker has its own scratch buffers.
+    template <class Line>
+    static void for_each_line(int count, unsigned threads, const Line& line)
+    {
+        const int block = 64;
+        int blocks = (count + block - 1) / block;
+        if (threads == 0)
+            threads = 1;
+        if (threads > unsigned(blocks))
+            threads = unsigned(blocks);
+        std::atomic<int> next{0};
+        auto work = [&]()
+        {
+            line_buffers buffers;
+            for (int b = next.fetch_add(1); b < blocks; b = next.fetch_add(1))
+                for (int index = b * block; index < std::min(count, (b + 1) * block); index++)
+                    line(index, buffers);
+        };
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; t++)
+            workers.emplace_back(work);
+        work();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    // In place 1D squared distance transform of count values: values[q] becomes
+    // min over p of (q - p)^2 + values[p]. Computed in double, the squares of long rows
+    // exceed float precision.
+    static void squared_transform(float* values, int count, line_buffers& b)
+    {
+        b.f.assign(values, values + count);
+        b.v.resize(count);
+        b.z.resize(count + 1);
+        int k = 0;
+        b.v[0] = 0;
+        b.z[0] = -INFINITY;
+        b.z[1] = INFINITY;
+        for (int q = 1; q < count; q++)
+        {
+            double s = intersection(b, q, b.v[k]);
+            while (s <= b.z[k])
+                s = intersection(b, q, b.v[--k]);
+            k++;
+            b.v[k] = q;
+            b.z[k] = s;
+            b.z[k + 1] = INFINITY;
+        }
+        k = 0;
+        for (int q = 0; q < count; q++)
+        {
+            while (b.z[k + 1] < double(q))
+                k++;
+            double dq = double(q - b.v[k]);
+            values[q] = float(dq * dq + b.f[b.v[k]]);
+        }
+    }
+    // Where the parabolas rooted at q and p cross.
+    inline static double intersection(const line_buffers& b, int q, int p)
+    {
+        return ((b.f[q] + double(q) * q) - (b.f[p] + double(p) * p)) / (2.0 * double(q - p));
+    }
+};
+
+// -- FOOTPRINTS -- //
+
+// A vehicle's outline as a few discs centred on its heading line, the usual cover that
+// turns a footprint check into one clearance lookup per disc. offset is how far ahead of
+// the state's position (along its heading) a disc's centre lies. No discs is a point agent.
+struct footprint
+{
+    static constexpr int max_discs = 8;
+    int disc_count = 0;
+    float offset[max_discs] = {};
+    float radius[max_discs] = {};
+
+    // A disc of radius r centred on the state's position.
+    static footprint circle(float r)
+    {
+        footprint f;
+        f.disc_count = 1;
+        f.radius[0] = r;
+        return f;
+    }
+
+    // A length x width rectangle along the heading whose centre lies center_ahead in front of
+    // the state's position (e.g. half the wheelbase for a rear-axle reference point). Covered
+    // by ceil(length / width) discs, at most max_discs, so it is checked slightly inflated at
+    // the corners. The backward side of BidirectionalAStar checks its states facing the other
+    // way, which is the same pose only for center_ahead == 0.
+    static footprint rectangle(float length, float width, float center_ahead = 0)
+    {
+        footprint f;
+        f.disc_count = std::clamp(int(ceilf(length / width)), 1, max_discs);
+        float piece = length / float(f.disc_count);
+        float r = sqrtf(0.25f * width * width + 0.25f * piece * piece);
+        for (int i = 0; i < f.disc_count; i++)
+        {
+            f.offset[i] = center_ahead - 0.5f * length + (float(i) + 0.5f) * piece;
+            f.radius[i] = r;
+        }
+        return f;
+    }
+};
+
+// -- COLLISION CHECKS -- //
+
+// Checks footprint poses and the motions between them against a distance field. A motion is
+// swept by sphere tracing: the clearance left around every disc bounds how far the vehicle
+// can move before any disc can touch an obstacle, so open space is crossed in one or two
+// lookups and only tight spots are sampled densely. Poses closer than tolerance to an
+// obstacle count as colliding, which also bounds the number of samples per motion.
+class collision_checker
+{
+public:
+    const distance_field* field = nullptr;
+    footprint shape;
+    float tolerance = 0.01f;
+
+    collision_checker() {}
+    collision_checker(const distance_field& distances, const footprint& vehicle)
+        : field(&distances), shape(vehicle)
+    {
+    }
+
+    // Smallest clearance left around the footprint's discs at a pose; negative when it
+    // overlaps an obstacle or leaves the map.
+    inline float margin(const vector2d& position, const vector2d& direction) const
+    {
+        float least = INFINITY;
+        for (int i = 0; i < shape.disc_count; i++)
+            least = std::min(least, field->clearance(position + direction * shape.offset[i]) - shape.radius[i]);
+        return least;
+    }
+
+    inline bool pose_free(const vector2d& position, const vector2d& direction) const
+    {
+        return margin(position, direction) >= tolerance;
+    }
+
+    // Whether the footprint stays free driving from the pose (from, direction) to the point to,
+    // straight along the chord or along the turning circle of the given radius on the side kind
+    // names. The kind comes from the successor's construction, not from where to lies: a motion
+    // table's successors start from a quantized state, so they are off the real state's heading
+    // line and circles by up to half a quantization step.
+    bool motion_free(const vector2d& from, const vector2d& direction, const vector2d& to, float turning_radius, motion_kind kind) const
+    {
+        vector2d chord = to - from;
+        float length = chord.magnitude();
+        if (kind == motion_kind::straight || length == 0)
+        {
+            vector2d along = length > 0 ? chord / length : direction;
+            for (float s = 0; s < length;)
+            {
+                float m = margin(from + along * s, direction);
+                if (m < tolerance)
+                    return false;
+                s += m;
+            }
+            return pose_free(to, direction);
+        }
+        // a disc centred d ahead of the position sweeps sqrt(r^2 + d^2) / r times as fast
+        float reach = 0;
+        for (int i = 0; i < shape.disc_count; i++)
+            reach = std::max(reach, fabsf(shape.offset[i]));
+        float speed = sqrtf(turning_radius * turning_radius + reach * reach) / turning_radius;
+        int side = kind == motion_kind::left ? 1 : 0;
+        float sign = kind == motion_kind::left ? 1.0f : -1.0f;
+        vector2d center = from + direction.perpendicular(side) * turning_radius;
+        vector2d arm = from - center;
+        float angle = 2 * asinf(std::min(1.0f, 0.5f * length / turning_radius));
+        for (float s = 0; s < angle * turning_radius;)
+        {
+            float a = sign * s / turning_radius;
+            float c = cosf(a), sn = sinf(a);
+            vector2d heading(direction.x * c - direction.y * sn, direction.x * sn + direction.y * c);
+            float m = margin(center + vector2d(arm.x * c - arm.y * sn, arm.x * sn + arm.y * c), heading);
+            if (m < tolerance)
+                return false;
+            s += m / speed;
+        }
+        return pose_free(to, (to - center).perpendicular(side).normalize());
+    }
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <math.h>
+
+class vector2d
+{
+public:
+    float x, y;
+    vector2d() : x(0), y(0) {}
+    vector2d(float a, float b) : x(a), y(b) {}
+
+    // basic operations
+
+    vector2d operator+(const vector2d& other) const
+    {
+        return vector2d(x + other.x, y + other.y);
+    }
+    vector2d operator-(const vector2d& other) const
+    {
+        return vector2d(x - other.x, y - other.y);
+    }
+    vector2d operator*(float scalar) const
+    {
+        return vector2d(x * scalar, y * scalar);
+    }
+    vector2d operator/(float scalar) const
+    {
+        return vector2d(x / scalar, y / scalar);
+    }
+    bool operator==(const vector2d& other) const
+    {
+        return x == other.x && y == other.y;
+    }
+    bool operator!=(const vector2d& other) const
+    {
+        return !(*this == other);
+    }
+
+
+    // math functions
+
+    inline float magnitude() const
+    {
+        return sqrt(x * x + y * y);
+    }
+    inline vector2d normalize() const
+    {
+        float mag = magnitude();
+        return vector2d(x / mag, y / mag);
+    }
+    inline float dot(const vector2d& other) const
+    {
+        return x * other.x + y * other.y;
+    }
+    inline vector2d crossproduct(const vector2d& other) const
+    {
+        return vector2d(y * other.x - x * other.y, x * other.y - y * other.x);
+    }
+    inline vector2d perpendicular(int mode) const
+    {
+        if (mode == 0) // right
+            return vector2d(y, -x);
+        else // left
+            return vector2d(-y, x);
+    }
+
+};
+
+// Fixed-point headings: a direction stored as its angle in 1/65536ths of a turn.
+inline std::uint16_t encode_heading(const vector2d& direction)
+{
+    float turns = atan2f(direction.y, direction.x) * float(65536 / (2 * M_PI));
+    return std::uint16_t(int(lrintf(turns)) & 0xffff);
+}
+inline vector2d decode_heading(std::uint16_t heading)
+{
+    float angle = float(heading) * float(2 * M_PI / 65536);
+    return vector2d(cosf(angle), sinf(angle));
+}
+
+// How a successor is reached from its state: straight ahead or along the turning circle on
+// one side (perpendicular(1) is left).
+enum class motion_kind : std::uint8_t
+{
+    straight,
+    left,
+    right
+};
+
+class obstacle
+{
+public:
+    int x, y, width, height;
+    obstacle() : x(0), y(0), width(1), height(1) {}
+    obstacle(int a, int b, int c, int d) : x(a), y(b), width(c), height(d) {}
+};
@@ -0,0 +1,204 @@
+#pragma once
+#include <vector>
+#include <math.h>
+#include "geometry.h"
+
+enum class heuristic_mode
+{
+    euclidean, // straight-line distance to the goal corner (original behaviour)
+    dubins     // forward-only Dubins distance for the query's turning radius
+};
+
+// Shortest forward-only path length from the origin, heading along +x, to the point (gx, gy)
+// with a free final heading, for minimum turning radius r. Points outside both turning circles
+// are reached by a turn and a straight leg in closed form; for points inside one, the first
+// turning arc is searched at a fixed angular step, overshooting by at most r * step.
+inline float dubins_point_distance(float gx, float gy, float r, int arc_steps = 128)
+{
+    // left turn then straight; infinite when the goal lies inside the left turning circle
+    auto left_straight = [r](float px, float py) -> float
+    {
+        float vx = px, vy = py - r;
+        float d2 = vx * vx + vy * vy;
+        if (d2 < r * r)
+            return INFINITY;
+        float t = sqrtf(d2 - r * r);
+        float theta = atan2f(vy, vx) - atan2f(t, r);
+        float arc = theta + float(M_PI / 2);
+        arc = fmodf(arc, float(2 * M_PI));
+        if (arc < 0)
+            arc += float(2 * M_PI);
+        return r * arc + t;
+    };
+    if (gy < 0)
+        gy = -gy; // mirror symmetry: only goals on the left need to be handled
+    float left = left_straight(gx, gy);
+    float right = left_straight(gx, -gy);
+    float best = right < left ? right : left;
+    if (left < INFINITY && right < INFINITY)
+        return best; // outside both turning circles a single turn plus a straight leg is optimal
+    // inside a turning circle: turn away first, then finish with a turn back and a straight leg
+    float step = float(2 * M_PI) / arc_steps;
+    for (int i = 1; i < arc_steps; i++)
+    {
+        float psi = i * step;
+        if (r * psi >= best)
+            break;
+        float s = sinf(psi), c = cosf(psi);
+        // after psi on the right circle: position (r sin psi, r cos psi - r), heading -psi
+        float px = gx - r * s, py = gy - (r * c - r);
+        float lx = px * c - py * s, ly = px * s + py * c;
+        float candidate = r * psi + left_straight(lx, ly);
+        // after psi on the left circle: position (r sin psi, r - r cos psi), heading +psi
+        px = gx - r * s; py = gy - (r - r * c);
+        lx = px * c + py * s; ly = -px * s + py * c;
+        float mirrored = r * psi + left_straight(lx, -ly);
+        if (mirrored < candidate)
+            candidate = mirrored;
+        if (candidate < best)
+            best = candidate;
+    }
+    return best;
+}
+
+// Precomputed Dubins distance table for one turning radius. The goal heading is free, so the
+// distance only depends on where the goal sits in the agent's frame (forward u, lateral v);
+// mirror symmetry folds v to v >= 0. The search ends on entering any point of the goal cell,
+// so each entry stores the minimum exact distance over every goal point within tolerance
+// (half the cell diagonal) of any position in the entry's bin, minus the arc-search slack.
+// That keeps a lookup at or below the true remaining path length to the goal cell, up to the
+// sampling resolution. Goals farther than range fall back to the straight-line bound.
+class dubins_table
+{
+public:
+    float radius = 0;
+    float range = 0;
+    float tolerance = 0;
+    int bins = 0; // per radius-sized half axis: the table is (2 * bins) x bins
+
+    dubins_table() {}
+    dubins_table(float r, float goal_tolerance = float(M_SQRT1_2), int bin_count = 128, float range_in_radii = 6.0f)
+    {
+        build(r, goal_tolerance, bin_count, range_in_radii);
+    }
+
+    void build(float r, float goal_tolerance = float(M_SQRT1_2), int bin_count = 128, float range_in_radii = 6.0f)
+    {
+        const int arc_steps = 128;
+        radius = r;
+        range = r * range_in_radii;
+        tolerance = goal_tolerance;
+        bins = bin_count;
+        step = range / bins;
+        float slack = r * float(2 * M_PI) / arc_steps;
+        // exact distances on the bin corners: u in [-range, range], v in [0, range]
+        int us = 2 * bins + 1, vs = bins + 1;
+        std::vector<float> exact(std::size_t(us) * vs);
+        for (int i = 0; i < us; i++)
+            for (int j = 0; j < vs; j++)
+                exact[std::size_t(i) * vs + j] = dubins_point_distance(-range + i * step, j * step, r, arc_steps);
+        // min-filter over the goal disk widened by the bin's half diagonal and one sample spacing
+        float reach = tolerance + step * (float(M_SQRT1_2) + 1);
+        int span = int(ceilf(reach / step));
+        table.assign(std::size_t(2 * bins) * bins, 0);
+        for (int i = 0; i < 2 * bins; i++)
+        {
+            for (int j = 0; j < bins; j++)
+            {
+                float cu = -range + (i + 0.5f) * step, cv = (j + 0.5f) * step;
+                float lowest = INFINITY;
+                for (int a = i - span; a <= i + 1 + span; a++)
+                {
+                    if (a < 0 || a >= us)
+                        continue;
+                    for (int b = j - span; b <= j + 1 + span; b++)
+                    {
+                        int mirrored = b < 0 ? -b : b; // goals on the other side mirror onto v >= 0
+                        if (mirrored >= vs)
+                            continue;
+                        float du = -range + a * step - cu, dv = b * step - cv;
+                        if (du * du + dv * dv > reach * reach)
+                            continue;
+                        float v = exact[std::size_t(a) * vs + mirrored];
+                        lowest = v < lowest ? v : lowest;
+                    }
+                }
+                float nearest = sqrtf(cu * cu + cv * cv) - step * float(M_SQRT1_2) - tolerance;
+                float value = lowest - slack;
+                value = value > nearest ? value : nearest;
+                table[std::size_t(i) * bins + j] = value > 0 ? value : 0;
+            }
+        }
+    }
+
+    // Lower bound on the forward path length from (position, heading) to any point within
+    // tolerance of target, or 0 when target is out of the table's range. direction must be
+    // normalized.
+    inline float lookup(const vector2d& position, const vector2d& direction, const vector2d& target) const
+    {
+        vector2d to_target = target - position;
+        float u = direction.dot(to_target);
+        float v = fabsf(direction.x * to_target.y - direction.y * to_target.x);
+        if (u <= -range || u >= range || v >= range)
+            return 0;
+        // rounding can put u just below range, or v just below it, one bin past the last
+        int i = int((u + range) / step), j = int(v / step);
+        i = i < 2 * bins - 1 ? i : 2 * bins - 1;
+        j = j < bins - 1 ? j : bins - 1;
+        return table[std::size_t(i) * bins + std::size_t(j)];
+    }
+
+    inline std::size_t memory_bytes() const
+    {
+        return table.capacity() * sizeof(float);
+    }
+
+private:
+    float step = 1;
+    std::vector<float> table;
+};
+
+// Heuristic used by AStar::get_path. Entering any point of the goal cell ends the search, so
+// dubins mode takes the larger of the table lookup towards the cell's centre (whose tolerance
+// covers the rest of the cell) and the straight-line distance to the cell's square.
+class heuristic
+{
+public:
+    heuristic_mode mode = heuristic_mode::euclidean;
+    const dubins_table* table = nullptr;
+
+    heuristic() {}
+    heuristic(const dubins_table* t) : mode(heuristic_mode::dubins), table(t) {}
+
+    inline float estimate(const vector2d& position, const vector2d& direction, int goal_x, int goal_y) const
+    {
+        if (mode == heuristic_mode::dubins && table != nullptr)
+        {
+            float dx = fmaxf(fmaxf(goal_x - position.x, position.x - (goal_x + 1)), 0.0f);
+            float dy = fmaxf(fmaxf(goal_y - position.y, position.y - (goal_y + 1)), 0.0f);
+            float straight = sqrtf(dx * dx + dy * dy);
+            float turning = table->lookup(position, direction.normalize(), vector2d(goal_x + 0.5f, goal_y + 0.5f));
+            return turning > straight ? turning : straight;
+        }
+        return (position - vector2d(goal_x, goal_y)).magnitude();
+    }
+
+    // Square of a cheap lower bound on estimate(): the straight-line part alone in dubins
+    // mode, the estimate itself otherwise. Lets a minimum over many goals skip most lookups
+    // and square roots.
+    inline float bound_squared(const vector2d& position, int goal_x, int goal_y) const
+    {
+        float dx, dy;
+        if (mode == heuristic_mode::dubins && table != nullptr)
+        {
+            dx = fmaxf(fmaxf(goal_x - position.x, position.x - (goal_x + 1)), 0.0f);
+            dy = fmaxf(fmaxf(goal_y - position.y, position.y - (goal_y + 1)), 0.0f);
+        }
+        else
+        {
+            dx = position.x - goal_x;
+            dy = position.y - goal_y;
+        }
+        return dx * dx + dy * dy;
+    }
+};
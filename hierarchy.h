@@ -0,0 +1,616 @@
+#pragma once
+#include <atomic>
+#include <queue>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include "main.h"
+
+// HPA*-style abstraction of a grid for one turning radius. The grid is cut into square
+// clusters; along every free stretch of border shared by two clusters, transitions are placed
+// a few cells apart. Each transition lets the agent enter the cluster behind it in three poses
+// (head-on and at +-45 degrees to the border), and every such entry is connected to the
+// transitions it can leave through by a search with the normal circle/line successors,
+// confined to the cluster and a one-cell rim. Leaving through any cell across a side counts
+// and is attributed to the nearest transition on that side and the entry heading closest to
+// the heading on arrival, so an edge only exists when the turn is actually drivable.
+//
+// get_path searches the abstract graph first, then refines the route one cluster at a time:
+// each leg is a full-resolution search confined to one cluster (and its rim) from wherever
+// the previous leg ended to the next transition, so the cost grows with the route length, not
+// with the explored area. Stitched paths are a few percent longer than optimal. When a leg
+// fails - the abstraction is approximate - the whole query is searched again inside a
+// corridor of the route's clusters plus a one-cluster margin, and as a last resort without
+// restriction, so a path is found whenever AStar::get_path would find one.
+
+// Transition on one side of a cluster: the border cell inside it and the free stretch of
+// border it serves. Both clusters sharing a border list the same transitions in the same order.
+struct cluster_transition
+{
+    int x = 0, y = 0;
+    int run_first = 0, run_last = 0; // stretch along the side, in x or y coordinates
+};
+
+// Leaving through a transition of this cluster, into the matching entry of the neighbour.
+struct cluster_edge
+{
+    int side = 0;       // 0 left, 1 right, 2 top, 3 bottom
+    int transition = 0; // index into the side's transitions
+    int heading = 0;    // entry heading index on the other side
+    float cost = 0;     // path length from the entry into the cell across the side
+};
+
+struct cluster_node
+{
+    std::vector<cluster_transition> sides[4];
+    std::vector<cluster_edge> edges;   // grouped by entry
+    std::vector<int> edge_begin;       // edges of entry i are [edge_begin[i], edge_begin[i + 1])
+
+    // entries are numbered side by side, transition by transition, heading by heading
+    inline int entry_count() const
+    {
+        return 3 * int(sides[0].size() + sides[1].size() + sides[2].size() + sides[3].size());
+    }
+    inline int entry_index(int side, int transition, int heading) const
+    {
+        int base = 0;
+        for (int i = 0; i < side; i++)
+            base += int(sides[i].size());
+        return 3 * (base + transition) + heading;
+    }
+    inline void entry_location(int entry, int& side, int& transition, int& heading) const
+    {
+        heading = entry % 3;
+        transition = entry / 3;
+        side = 0;
+        while (transition >= int(sides[side].size()))
+            transition -= int(sides[side++].size());
+    }
+};
+
+struct hierarchy_stats
+{
+    std::size_t expansions = 0;        // full-resolution states expanded by all of the query's searches
+    std::size_t peak_frontier = 0;
+    std::size_t abstract_expansions = 0;
+    std::size_t local_searches = 0;    // cluster-confined searches run for the start and goal
+    std::size_t legs = 0;              // route legs refined by cluster-confined searches
+    bool stitched = false;             // the path was stitched from the route legs
+    bool refined = false;              // the path came from the corridor-restricted search
+    bool fallback = false;             // the unrestricted search had to be used
+};
+
+class ClusterHierarchy
+{
+public:
+    int cluster_size = 16;
+    int spacing = 4; // cells between transitions along a free stretch of border
+    int columns = 0, rows = 0;
+    float radius = 1;
+    std::vector<cluster_node> clusters;
+
+    // Builds the whole abstraction, spreading the clusters over threads workers. The grid must
+    // not change while the hierarchy is in use; call rebuild_area() after editing it.
+    ClusterHierarchy(std::shared_ptr<const occupancy_grid> map, float turning_radius, int size = 16, unsigned threads = std::thread::hardware_concurrency())
+        : cluster_size(size < 4 ? 4 : size), spacing(cluster_size / 4), radius(turning_radius), grid(std::move(map))
+    {
+        columns = (grid->width + cluster_size - 1) / cluster_size;
+        rows = (grid->height + cluster_size - 1) / cluster_size;
+        clusters.resize(std::size_t(columns) * rows);
+        std::vector<int> all(clusters.size());
+        for (std::size_t i = 0; i < all.size(); i++)
+            all[i] = int(i);
+        rebuild(all, threads);
+    }
+
+    inline int cluster_of(int x, int y) const
+    {
+        return (y / cluster_size) * columns + x / cluster_size;
+    }
+
+    // Recomputes the transitions and edges of the given clusters, threads clusters at a time.
+    // Transitions depend on the cells on both sides of a border, so after editing cells the
+    // clusters containing them must be rebuilt together with their neighbours (rebuild_area).
+    void rebuild(std::span<const int> ids, unsigned threads = std::thread::hardware_concurrency())
+    {
+        for (int id : ids)
+            find_transitions(id);
+        if (threads == 0)
+            threads = 1;
+        if (threads > ids.size())
+            threads = unsigned(ids.size());
+        std::atomic<std::size_t> next{0};
+        auto work = [&]()
+        {
+            SearchContext context(16); // the edges are approximate anyway; halve the lattice
+
+            for (std::size_t i = next.fetch_add(1); i < ids.size(); i = next.fetch_add(1))
+                connect_entries(ids[i], context);
+        };
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < threads; i++)
+            workers.emplace_back(work);
+        work();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    // Rebuilds every cluster whose transitions or edges can be affected by edits to the cells
+    // [x, x + w) x [y, y + h).
+    void rebuild_area(int x, int y, int w, int h, unsigned threads = std::thread::hardware_concurrency())
+    {
+        int cx0 = std::max(x / cluster_size - 1, 0), cy0 = std::max(y / cluster_size - 1, 0);
+        int cx1 = std::min((x + w - 1) / cluster_size + 1, columns - 1), cy1 = std::min((y + h - 1) / cluster_size + 1, rows - 1);
+        std::vector<int> ids;
+        for (int cy = cy0; cy <= cy1; cy++)
+            for (int cx = cx0; cx <= cx1; cx++)
+                ids.push_back(cy * columns + cx);
+        rebuild(ids, threads);
+    }
+
+    // Same contract as AStar::get_path; query.radius must match the hierarchy's radius.
+    // context.expansions and peak_frontier cover every search the query ran. Thread-safe for
+    // concurrent queries on separate contexts.
+    bool get_path(SearchContext& context, const Query& query, std::vector<std::size_t>& path, const heuristic& h = heuristic(), hierarchy_stats* stats = nullptr) const
+    {
+        hierarchy_stats local_stats;
+        hierarchy_stats& s = stats != nullptr ? *stats : local_stats;
+        s = hierarchy_stats();
+        bool found = false;
+        if (AStar::valid_query(*grid, query))
+        {
+            found = plan(context, query, path, h, s);
+        }
+        else
+        {
+            context.reset(grid->width, grid->height);
+            path.clear();
+        }
+        context.expansions = s.expansions;
+        context.peak_frontier = s.peak_frontier;
+        return found;
+    }
+
+    inline std::size_t memory_bytes() const
+    {
+        std::size_t bytes = clusters.capacity() * sizeof(cluster_node);
+        for (const auto& c : clusters)
+        {
+            for (const auto& side : c.sides)
+                bytes += side.capacity() * sizeof(cluster_transition);
+            bytes += c.edges.capacity() * sizeof(cluster_edge) + c.edge_begin.capacity() * sizeof(int);
+        }
+        return bytes;
+    }
+
+private:
+    std::shared_ptr<const occupancy_grid> grid;
+
+    // Adds the work of the search that just ran on context to the query's totals.
+    static inline bool count(const SearchContext& context, hierarchy_stats& s, bool found = true)
+    {
+        s.expansions += context.expansions;
+        s.peak_frontier = std::max(s.peak_frontier, context.peak_frontier);
+        return found;
+    }
+
+    bool plan(SearchContext& context, const Query& query, std::vector<std::size_t>& path, const heuristic& h, hierarchy_stats& s) const
+    {
+        std::vector<std::uint64_t> route;
+        if (query.region == nullptr && grid->in_bounds(query.goal_x, query.goal_y) && abstract_route(context, query, route, s))
+        {
+            if (stitch(context, query, route, path, h, s))
+            {
+                s.stitched = true;
+                return true;
+            }
+            std::vector<std::uint8_t> corridor(clusters.size(), 0);
+            for (std::uint64_t k : route)
+                widen(corridor, int(k >> 32));
+            widen(corridor, cluster_of(int(query.start.x), int(query.start.y)));
+            widen(corridor, cluster_of(query.goal_x, query.goal_y));
+            search_region region;
+            region.x1 = grid->width;
+            region.y1 = grid->height;
+            region.cluster_size = cluster_size;
+            region.columns = columns;
+            region.allowed = corridor.data();
+            Query refined = query;
+            refined.region = &region;
+            if (count(context, s, AStar::get_path(*grid, context, refined, path, h)))
+            {
+                s.refined = true;
+                return true;
+            }
+        }
+        s.fallback = true;
+        return count(context, s, AStar::get_path(*grid, context, query, path, h));
+    }
+
+    // A cell across one side of the cluster that a local search tries to reach.
+    struct exit_target
+    {
+        std::size_t cell;
+        int side;
+        int offset; // position along the side
+    };
+
+    static inline vector2d outward(int side)
+    {
+        return vector2d(side == 0 ? -1.0f : (side == 1 ? 1.0f : 0.0f), side == 2 ? -1.0f : (side == 3 ? 1.0f : 0.0f));
+    }
+    static inline int opposite(int side)
+    {
+        return side ^ 1;
+    }
+    // Entry heading through a side: head-on, or turned 45 degrees either way.
+    static inline vector2d entry_direction(int side, int heading)
+    {
+        vector2d inward = outward(side) * -1.0f;
+        vector2d across(inward.y, -inward.x);
+        return (inward + across * float(heading - 1)).normalize();
+    }
+    // Entry pose of a transition: on the border, just inside the cluster.
+    inline void entry_pose(int id, int entry, vector2d& position, vector2d& direction) const
+    {
+        int side, transition, heading;
+        clusters[id].entry_location(entry, side, transition, heading);
+        const cluster_transition& t = clusters[id].sides[side][transition];
+        position = vector2d(t.x + 0.5f, t.y + 0.5f) + outward(side) * 0.49f;
+        direction = entry_direction(side, heading);
+    }
+
+    // Cells of a cluster, widened by margin cells on every side.
+    inline search_region cluster_region(int id, int margin = 0) const
+    {
+        search_region region;
+        region.x0 = std::max((id % columns) * cluster_size - margin, 0);
+        region.y0 = std::max((id / columns) * cluster_size - margin, 0);
+        region.x1 = std::min((id % columns + 1) * cluster_size + margin, grid->width);
+        region.y1 = std::min((id / columns + 1) * cluster_size + margin, grid->height);
+        return region;
+    }
+
+    // Longest route a cluster-confined search follows: crossing the cluster twice plus a
+    // full turning circle. Longer routes loop and are better found through other clusters.
+    inline float local_cost_limit() const
+    {
+        return 1.5f * float(cluster_size) + float(M_PI) * radius;
+    }
+
+    // Scans the four borders of a cluster for free stretches and spreads transitions over
+    // them, spacing cells apart. Both clusters sharing a border scan it the same way.
+    void find_transitions(int id)
+    {
+        cluster_node& c = clusters[id];
+        search_region box = cluster_region(id);
+        for (int side = 0; side < 4; side++)
+        {
+            c.sides[side].clear();
+            int nx = int(outward(side).x), ny = int(outward(side).y);
+            bool vertical = side < 2;
+            int fixed = side == 0 ? box.x0 : (side == 1 ? box.x1 - 1 : (side == 2 ? box.y0 : box.y1 - 1));
+            int first = vertical ? box.y0 : box.x0, last = vertical ? box.y1 : box.x1;
+            int run_start = -1;
+            for (int i = first; i <= last; i++)
+            {
+                bool open = false;
+                if (i < last)
+                {
+                    int x = vertical ? fixed : i, y = vertical ? i : fixed;
+                    open = grid->is_free(x, y) && grid->is_free(x + nx, y + ny);
+                }
+                if (open && run_start < 0)
+                    run_start = i;
+                if (!open && run_start >= 0)
+                {
+                    int length = i - run_start;
+                    int count = std::max((length + spacing / 2) / spacing, 1);
+                    for (int k = 0; k < count; k++)
+                    {
+                        int at = run_start + (2 * k + 1) * length / (2 * count);
+                        cluster_transition t;
+                        t.x = vertical ? fixed : at;
+                        t.y = vertical ? at : fixed;
+                        t.run_first = run_start;
+                        t.run_last = i - 1;
+                        c.sides[side].push_back(t);
+                    }
+                    run_start = -1;
+                }
+            }
+        }
+    }
+
+    // Free cells just outside the cluster's four sides.
+    void exit_targets(int id, std::vector<exit_target>& targets) const
+    {
+        search_region box = cluster_region(id);
+        targets.clear();
+        for (int side = 0; side < 4; side++)
+        {
+            bool vertical = side < 2;
+            int fixed = side == 0 ? box.x0 - 1 : (side == 1 ? box.x1 : (side == 2 ? box.y0 - 1 : box.y1));
+            int first = vertical ? box.y0 : box.x0, last = vertical ? box.y1 : box.x1;
+            if (clusters[id].sides[side].empty())
+                continue;
+            for (int i = first; i < last; i++)
+            {
+                int x = vertical ? fixed : i, y = vertical ? i : fixed;
+                if (grid->is_free(x, y))
+                    targets.push_back(exit_target{grid->index(x, y), side, i});
+            }
+        }
+    }
+
+    // Runs a cluster-confined search from a pose towards the exit targets (and extra_target,
+    // when given). costs/directions follow targets, with extra_target last.
+    void search_exits(int id, SearchContext& context, const vector2d& position, const vector2d& direction, const std::vector<exit_target>& targets, std::size_t extra_target, bool use_extra, float limit, std::vector<float>& costs, std::vector<vector2d>& directions) const
+    {
+        std::vector<std::size_t> cells;
+        for (const auto& t : targets)
+            cells.push_back(t.cell);
+        if (use_extra)
+            cells.push_back(extra_target);
+        costs.resize(cells.size());
+        directions.resize(cells.size());
+        search_region box = cluster_region(id, 1);
+        Query local;
+        local.start = position;
+        local.direction = direction;
+        local.radius = radius;
+        local.region = &box;
+        AStar::get_costs(*grid, context, local, cells.data(), int(cells.size()), costs.data(), directions.data(), limit);
+    }
+
+    // Transition and entry heading on the far side that best match leaving through a target
+    // with the given heading; false when no free stretch of the side covers the target.
+    bool resolve_exit(int id, const exit_target& target, const vector2d& direction, int& transition, int& heading) const
+    {
+        const auto& side = clusters[id].sides[target.side];
+        if (side.empty() || direction.dot(outward(target.side)) <= 0)
+            return false;
+        bool vertical = target.side < 2;
+        int best_distance = 1 << 30;
+        for (std::size_t i = 0; i < side.size(); i++)
+        {
+            if (target.offset < side[i].run_first || target.offset > side[i].run_last)
+                continue;
+            int distance = std::abs((vertical ? side[i].y : side[i].x) - target.offset);
+            if (distance < best_distance)
+            {
+                best_distance = distance;
+                transition = int(i);
+            }
+        }
+        if (best_distance == 1 << 30)
+            return false;
+        float best_dot = -2;
+        for (int h = 0; h < 3; h++)
+        {
+            float d = entry_direction(opposite(target.side), h).dot(direction);
+            if (d > best_dot)
+            {
+                best_dot = d;
+                heading = h;
+            }
+        }
+        return true;
+    }
+
+    // Connects every entry of a cluster to the neighbouring entries it can drive to.
+    void connect_entries(int id, SearchContext& context)
+    {
+        cluster_node& c = clusters[id];
+        c.edges.clear();
+        int entries = c.entry_count();
+        c.edge_begin.assign(entries + 1, 0);
+        std::vector<exit_target> targets;
+        exit_targets(id, targets);
+        std::vector<float> costs;
+        std::vector<vector2d> directions;
+        for (int e = 0; e < entries; e++)
+        {
+            c.edge_begin[e] = int(c.edges.size());
+            vector2d position, direction;
+            entry_pose(id, e, position, direction);
+            search_exits(id, context, position, direction, targets, 0, false, local_cost_limit(), costs, directions);
+            for (std::size_t j = 0; j < targets.size(); j++)
+            {
+                cluster_edge edge;
+                if (costs[j] < 0 || !resolve_exit(id, targets[j], directions[j], edge.transition, edge.heading))
+                    continue;
+                edge.side = targets[j].side;
+                edge.cost = costs[j];
+                // keep the cheapest way to each neighbouring entry
+                bool merged = false;
+                for (int k = c.edge_begin[e]; k < int(c.edges.size()); k++)
+                {
+                    cluster_edge& other = c.edges[k];
+                    if (other.side == edge.side && other.transition == edge.transition && other.heading == edge.heading)
+                    {
+                        other.cost = std::min(other.cost, edge.cost);
+                        merged = true;
+                    }
+                }
+                if (!merged)
+                    c.edges.push_back(edge);
+            }
+        }
+        c.edge_begin[entries] = int(c.edges.size());
+    }
+
+    // Neighbouring cluster and its entry reached through an edge.
+    inline void edge_target(int id, const cluster_edge& edge, int& next, int& entry) const
+    {
+        int cx = id % columns + int(outward(edge.side).x), cy = id / columns + int(outward(edge.side).y);
+        next = cy * columns + cx;
+        entry = clusters[next].entry_index(opposite(edge.side), edge.transition, edge.heading);
+    }
+
+    // Flags a cluster and its eight neighbours in a corridor mask.
+    void widen(std::vector<std::uint8_t>& corridor, int id) const
+    {
+        int cx = id % columns, cy = id / columns;
+        for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, rows - 1); y++)
+            for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, columns - 1); x++)
+                corridor[std::size_t(y) * columns + x] = 1;
+    }
+
+    // Refines the route leg by leg. Each leg starts from the pose the previous one ended in and
+    // is confined to the current cluster and its rim. When a leg cannot reach its transition
+    // from that pose, the rest of the route is planned again from there, a few times at most.
+    bool stitch(SearchContext& context, const Query& query, std::vector<std::uint64_t> route, std::vector<std::size_t>& path, const heuristic& h, hierarchy_stats& s) const
+    {
+        const int max_replans = 8;
+        std::vector<std::size_t> forward, leg;
+        vector2d position = query.start, direction = query.direction;
+        int id = cluster_of(int(query.start.x), int(query.start.y));
+        float cost = 0;
+        int replans = 0;
+        for (std::size_t i = 0; i <= route.size(); i++)
+        {
+            Query local = query;
+            local.start = position;
+            local.direction = direction;
+            if (i < route.size())
+            {
+                int next = int(route[i] >> 32), side, transition, heading;
+                clusters[next].entry_location(int(route[i] & 0xffffffffu), side, transition, heading);
+                local.goal_x = clusters[next].sides[side][transition].x;
+                local.goal_y = clusters[next].sides[side][transition].y;
+            }
+            search_region box = cluster_region(id, 1);
+            local.region = &box;
+            s.legs++;
+            if (!count(context, s, AStar::get_path(*grid, context, local, leg, h)))
+            {
+                Query rest = query;
+                rest.start = position;
+                rest.direction = direction;
+                if (++replans > max_replans || !abstract_route(context, rest, route, s))
+                    return false;
+                i = std::size_t(-1); // continue with the new route's first leg
+                continue;
+            }
+            // legs share their junction cell
+            for (std::size_t j = leg.size(); j-- > 0;)
+                if (forward.empty() || forward.back() != leg[j])
+                    forward.push_back(leg[j]);
+            cost += context.path_cost;
+            position = context.path_position;
+            direction = context.path_direction;
+            if (i < route.size())
+                id = int(route[i] >> 32);
+        }
+        path.assign(forward.rbegin(), forward.rend());
+        context.path_cost = cost;
+        return true;
+    }
+
+    // A* over the entries. On success, route holds the entries from the start to the goal.
+    bool abstract_route(SearchContext& context, const Query& query, std::vector<std::uint64_t>& route, hierarchy_stats& s) const
+    {
+        using key = std::uint64_t; // cluster << 32 | entry
+        const key goal_key = ~key(0);
+        struct record
+        {
+            float g;
+            key parent;
+        };
+        std::unordered_map<key, record> records;
+        typedef std::pair<float, key> item;
+        std::priority_queue<item, std::vector<item>, std::greater<item>> open;
+        vector2d goal_center(query.goal_x + 0.5f, query.goal_y + 0.5f);
+        int start_cluster = cluster_of(int(query.start.x), int(query.start.y));
+        int goal_cluster = cluster_of(query.goal_x, query.goal_y);
+        std::size_t goal_cell = grid->index(query.goal_x, query.goal_y);
+        const key start_key = key(start_cluster) << 32 | 0xffffffffu;
+        auto estimate = [&](key k)
+        {
+            if (k == goal_key)
+                return 0.0f;
+            vector2d position, direction;
+            entry_pose(int(k >> 32), int(k & 0xffffffffu), position, direction);
+            return (goal_center - position).magnitude();
+        };
+        auto relax = [&](key k, float g, key parent)
+        {
+            auto found = records.find(k);
+            if (found != records.end() && found->second.g <= g)
+                return;
+            records[k] = record{g, parent};
+            open.push(item(g + estimate(k), k));
+        };
+        // the start and goal clusters are searched at full resolution from the actual pose
+        std::vector<exit_target> targets;
+        std::vector<std::size_t> leg;
+        std::vector<float> costs;
+        std::vector<vector2d> directions;
+        auto leave = [&](int id, const vector2d& position, const vector2d& direction, float g, key from)
+        {
+            exit_targets(id, targets);
+            search_exits(id, context, position, direction, targets, goal_cell, id == goal_cluster, local_cost_limit(), costs, directions);
+            count(context, s);
+            s.local_searches++;
+            for (std::size_t j = 0; j < targets.size(); j++)
+            {
+                cluster_edge edge;
+                if (costs[j] < 0 || !resolve_exit(id, targets[j], directions[j], edge.transition, edge.heading))
+                    continue;
+                edge.side = targets[j].side;
+                int next, entry;
+                edge_target(id, edge, next, entry);
+                relax(key(next) << 32 | key(entry), g + costs[j], from);
+            }
+            if (id == goal_cluster && costs.back() >= 0)
+                relax(goal_key, g + costs.back(), from);
+        };
+
+        records[start_key] = record{0, start_key};
+        leave(start_cluster, query.start, query.direction, 0, start_key);
+        bool reached = false;
+        while (!open.empty())
+        {
+            item top = open.top();
+            open.pop();
+            key k = top.second;
+            if (k == goal_key)
+            {
+                reached = true;
+                break;
+            }
+            float g = records[k].g;
+            if (top.first > g + estimate(k) + 1e-4f)
+                continue; // superseded by a cheaper push
+            s.abstract_expansions++;
+            int id = int(k >> 32), entry = int(k & 0xffffffffu);
+            if (id == goal_cluster)
+            {
+                // entering the goal's cluster: try to finish inside it, besides the usual edges
+                Query local = query;
+                entry_pose(id, entry, local.start, local.direction);
+                search_region box = cluster_region(id, 1);
+                local.region = &box;
+                s.local_searches++;
+                if (count(context, s, AStar::get_path(*grid, context, local, leg)))
+                    relax(goal_key, g + context.path_cost, k);
+            }
+            const cluster_node& c = clusters[id];
+            for (int e = c.edge_begin[entry]; e < c.edge_begin[entry + 1]; e++)
+            {
+                int next, next_entry;
+                edge_target(id, c.edges[e], next, next_entry);
+                relax(key(next) << 32 | key(next_entry), g + c.edges[e].cost, k);
+            }
+        }
+        if (!reached)
+            return false;
+
+        route.clear();
+        for (key k = records[goal_key].parent; k != start_key; k = records[k].parent)
+            route.push_back(k);
+        std::reverse(route.begin(), route.end());
+        return true;
+    }
+};
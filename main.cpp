@@ -1,139 +1,77 @@
 #include <iostream>
 #include <chrono>
+#include <string>
+#include <cstdlib>
 #include "main.h"
+#include "planner.h"
+#include "map_io.h"
+#include "bidirectional.h"
+#include "incremental.h"
+#include "anytime.h"
+#include "search_task.h"
+#include "trace_render.h"
 #include <windows.h>
 
-node* node::goal_node = nullptr;
-node* start_node = nullptr;
-std::vector<std::vector<node*>> map_grid;
-std::vector<std::vector<node*>> fov_grid;
-
-int global_width = 0;
-int global_height = 0;
+std::size_t start_cell = 0;
+std::size_t goal_cell = 0;
+occupancy_grid map_grid;
 
 // -- MAP CREATION -- //
 
-node* create_map(int width, int height, std::vector<obstacle> obs, int start_x, int start_y, int goal_x, int goal_y) 
+std::size_t create_map(int width, int height, const std::vector<obstacle>& obs, int start_x, int start_y, int goal_x, int goal_y) 
 {
-    map_grid.resize(height, std::vector<node*>(width, nullptr));
-    fov_grid.resize(height, std::vector<node*>(width, nullptr));
-    node* start_node = nullptr;
-    std::cout << "\n\n----------------------" << std::endl;
-    for (int y = 0; y < height; ++y) 
-    {
-        for (int x = 0; x < width; ++x) 
-        {
-            bool skip = false;
-            for (auto obs : obs) 
-            {
-                if (y >= obs.x && y < obs.x + obs.width && x >= obs.y && x < obs.y + obs.height) 
-                {
-                    //std::cout << "⬛";
-                    skip = true;
-                }
-            }
-            if (!skip)
-            {
-                //std::cout << "⬜";
-                node* newNode = new node();
-                newNode->x = x;
-                newNode->y = y;
-                if (x > 0 && map_grid[y][x - 1] != nullptr) 
-                {
-                    newNode->neighbors.push_back(map_grid[y][x - 1]);
-                    map_grid[y][x - 1]->neighbors.push_back(newNode);
-                }
-                if (y > 0 && map_grid[y - 1][x] != nullptr) 
-                {
-                    newNode->neighbors.push_back(map_grid[y - 1][x]);
-                    map_grid[y - 1][x]->neighbors.push_back(newNode);
-                }
-                map_grid[y][x] = newNode;
-                if (x == start_x && y == start_y) 
-                {
-                    start_node = newNode;
-                }
-                else if (x == goal_x && y == goal_y) 
-                {
-                    node::goal_node = newNode;
-                }
-            }
-        }
-        std::cout << std::endl;
-    }
-    std::cout << "----------------------\n\n" << std::endl; 
+    map_grid.resize(width, height);
+    rasterize(map_grid, obs);
+    goal_cell = map_grid.index(goal_x, goal_y);
     std::cout << "Map created!" << std::endl; 
-    global_height = height;
-    global_width = width;
-    return start_node;
+    return map_grid.index(start_x, start_y);
 }
 
 // -- PATH PRINTING -- //
 
-void print_path(const std::vector<node*>& path) 
+// Cells expanded by the search that produced path are drawn blue when context is given.
+void print_path(const std::vector<std::size_t>& path, const SearchContext* context = nullptr) 
 {
     for (int i = path.size() - 1; i >= 0; i--)
     {
-        auto n = path[i];
-        std::cout << "(" << n->x << ", " << n->y << ") -> ";
+        std::cout << "(" << map_grid.cell_x(path[i]) << ", " << map_grid.cell_y(path[i]) << ") -> ";
     }
     std::cout << "GOAL\n\n" << std::endl;
 
-    for (int y = 0; y < global_height; ++y) 
+    cell_image image;
+    image.assign(map_grid);
+    if (context != nullptr)
     {
-        for (int x = 0; x < global_width; ++x) 
-        {
-            bool on_path = false;
-            for (auto p_node : path) 
-            {
-                if (p_node->x == x && p_node->y == y) 
-                {
-                    on_path = true;
-                    break;
-                }
-            }
-            if (on_path && map_grid[y][x] != node::goal_node) 
-            {
-                if (map_grid[y][x] != start_node)
-                {
-                    std::cout << "\x1b[32m██\x1b[0m";
-                } 
-                else 
-                {
-                    std::cout << "\x1b[33m██\x1b[0m";
-                }
-            } 
-            else 
-            {
-                bool is_obstacle = true;
-                for (auto p_node : path) 
-                {
-                    if (map_grid[y][x] == p_node) 
-                    {
-                        is_obstacle = false;
-                        break;
-                    }
-                }
-                if (is_obstacle && map_grid[y][x] == nullptr) 
-                {
-                    std::cout << "\x1b[30m██\x1b[0m";
-                } 
-                else if (fov_grid[y][x] != nullptr && map_grid[y][x] != node::goal_node) 
-                {
-                    std::cout << "\x1b[34m██\x1b[0m";
-                }
-                else if (map_grid[y][x] == node::goal_node) 
-                {
-                    std::cout << "\x1b[31m██\x1b[0m";
-                }
-                else 
-                {
-                    std::cout << "\x1b[37m██\x1b[0m";
-                }
-            }
-        }
-        std::cout << std::endl;
+        for (int y = 0; y < map_grid.height; ++y)
+            for (int x = 0; x < map_grid.width; ++x)
+                if (context->visited(x, y))
+                    image.mark(x, y, cell_class::expanded);
+    }
+    for (auto cell : path)
+    {
+        image.mark(map_grid.cell_x(cell), map_grid.cell_y(cell), cell == start_cell ? cell_class::start : cell_class::path);
+    }
+    image.mark(map_grid.cell_x(goal_cell), map_grid.cell_y(goal_cell), cell_class::goal);
+    write_ansi(image, std::cout);
+}
+
+// Draws a trace saved by a build with ASTAR_TRACE over the map it was recorded on, as a PPM
+// image when out_path is given and on the terminal otherwise.
+bool render_trace(const char* trace_path, const char* map_path, const char* out_path, int scale)
+{
+    search_trace trace;
+    occupancy_grid grid;
+    if (!trace.load(trace_path) || !load_map_file(map_path, grid) || grid.width != trace.width || grid.height != trace.height)
+        return false;
+    cell_image image;
+    image.assign(grid);
+    image.overlay(trace);
+    if (out_path == nullptr)
+    {
+        write_ansi(image, std::cout);
+        return true;
     }
+    return write_ppm(image, out_path, scale);
 }
 
 // -- TURN-BASED FOV -- //
@@ -142,32 +80,179 @@ void print_path(const std::vector<node*>& path)
 
 // -- MAIN FUNCTION -- //
 
-int main() 
+// Usage: main.exe                                       built-in demo map
+//        main.exe map.grid|map.pgm|map.pbm [sx sy gx gy]  plan on a map file
+//        main.exe --convert image.pgm map.grid [threshold] convert an image to a .grid file
+//        main.exe --render search.trace map.grid [out.ppm [scale]]
+//                                                       draw a recorded search (ASTAR_TRACE builds
+//                                                       save the main query's as search.trace)
+int main(int argc, char** argv) 
 {
 
     std::cout << "Hello, World!" << std::endl; 
-    std::vector<obstacle> obstacles;
-    auto obs1 = obstacle(0, 3, 2, 2);
-    auto obs2 = obstacle(0, 4, 6, 2);
-    obstacles.push_back(obs1);
-    obstacles.push_back(obs2);
+    if (argc >= 4 && std::string(argv[1]) == "--convert")
+    {
+        bool converted = convert_pnm(argv[2], argv[3], argc >= 5 ? std::atoi(argv[4]) : 128);
+        std::cout << (converted ? "Map converted!" : "Map conversion failed.") << std::endl;
+        return converted ? 0 : 1;
+    }
+    if (argc >= 4 && std::string(argv[1]) == "--render")
+    {
+        bool rendered = render_trace(argv[2], argv[3], argc >= 5 ? argv[4] : nullptr, argc >= 6 ? std::atoi(argv[5]) : 1);
+        if (!rendered)
+            std::cout << "Could not render " << argv[2] << " over " << argv[3] << std::endl;
+        return rendered ? 0 : 1;
+    }
     int goal_x = 9;
     int goal_y = 5;
     vector2d start_pos(0, 2);
     vector2d start_dir(0, 1);
-    auto start = create_map(10, 10, obstacles, start_pos.x, start_pos.y, goal_x, goal_y);
-    start_node = start;
-    print_path(std::vector<node*>{start});
-    path_node* start_pathnode = new path_node(vector2d(start->x, start->y), start_dir, map_grid[start_pos.y][start_pos.x]);
-    path_node* goal_pathnode = new path_node(vector2d(node::goal_node->x, node::goal_node->y), vector2d(0,0), map_grid[goal_y][goal_x]);
-    fov_grid[start->y][start->x] = start;
+    if (argc >= 2)
+    {
+        auto load_start = std::chrono::high_resolution_clock::now();
+        if (!load_map_file(argv[1], map_grid))
+        {
+            std::cout << "Could not load map " << argv[1] << std::endl;
+            return 1;
+        }
+        auto load_end = std::chrono::high_resolution_clock::now();
+        std::cout << "Map loaded (" << map_grid.width << "x" << map_grid.height << ") in "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(load_end - load_start).count() << " microseconds" << std::endl;
+        if (argc >= 6)
+        {
+            start_pos = vector2d(std::atoi(argv[2]), std::atoi(argv[3]));
+            goal_x = std::atoi(argv[4]);
+            goal_y = std::atoi(argv[5]);
+        }
+        if (!map_grid.is_free(int(start_pos.x), int(start_pos.y)) || !map_grid.is_free(goal_x, goal_y))
+        {
+            std::cout << "Start or goal is not on a free cell of the map." << std::endl;
+            return 1;
+        }
+        start_cell = map_grid.index(int(start_pos.x), int(start_pos.y));
+        goal_cell = map_grid.index(goal_x, goal_y);
+    }
+    else
+    {
+        std::vector<obstacle> obstacles;
+        auto obs1 = obstacle(0, 3, 2, 2);
+        auto obs2 = obstacle(0, 4, 6, 2);
+        obstacles.push_back(obs1);
+        obstacles.push_back(obs2);
+        start_cell = create_map(10, 10, obstacles, start_pos.x, start_pos.y, goal_x, goal_y);
+    }
+    print_path(std::vector<std::size_t>{start_cell});
+    SearchContext context;
+#if ASTAR_TRACE
+    search_trace trace;
+    context.trace = &trace;
+#endif
+    std::vector<std::size_t> path;
+    Query query;
+    query.start = start_pos;
+    query.direction = start_dir;
+    query.goal_x = goal_x;
+    query.goal_y = goal_y;
+    query.radius = 5.5f;
     auto start_time = std::chrono::high_resolution_clock::now();
-    float radius = 5.5f;
-    auto path = AStar::get_path(start_pathnode, goal_pathnode, radius);
+    bool found = AStar::get_path(map_grid, context, query, path);
     auto end_time = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
-    std::cout << "Pathfinding took: " << duration << " microseconds" << std::endl;
-    print_path(path);
+    std::cout << (found ? "Path found!" : "No path found.") << std::endl;
+    std::cout << "Pathfinding took: " << duration << " microseconds (" << context.expansions << " states expanded)" << std::endl;
+    print_path(path, &context);
+#if ASTAR_TRACE
+    context.trace = nullptr;
+    if (trace.save("search.trace") && (argc >= 2 || save_map(map_grid, "demo.grid")))
+        std::cout << "Search trace saved to search.trace (" << trace.records.size() << " records), render it with --render search.trace "
+                  << (argc >= 2 ? argv[1] : "demo.grid") << std::endl;
+#endif
+
+    // the same query from every axis heading, both heuristics, on the worker pool
+    // map_grid outlives the planner, so it is shared without copying (a loaded map stays mapped)
+    Planner planner(std::shared_ptr<const occupancy_grid>(&map_grid, [](const occupancy_grid*) {}));
+    std::vector<Query> batch;
+    for (auto mode : {heuristic_mode::euclidean, heuristic_mode::dubins})
+    {
+        for (auto dir : {vector2d(1, 0), vector2d(0, 1), vector2d(-1, 0), vector2d(0, -1)})
+        {
+            query.direction = dir;
+            query.heuristic = mode;
+            batch.push_back(query);
+        }
+    }
+    std::vector<QueryResult> results(batch.size());
+    planner.plan_batch(batch, results);
+    for (std::size_t i = 0; i < batch.size(); i++)
+    {
+        std::cout << (batch[i].heuristic == heuristic_mode::dubins ? "dubins    " : "euclidean ")
+                  << "heading (" << batch[i].direction.x << ", " << batch[i].direction.y << "): "
+                  << (results[i].found ? "found, " : "no path, ") << results[i].expansions << " states expanded" << std::endl;
+    }
+
+    // bidirectional mode: the main query from both ends, then with its goal cell blocked, where
+    // both searches must give up
+    {
+        query.direction = start_dir;
+        query.heuristic = heuristic_mode::euclidean;
+        occupancy_grid blocked_goal = map_grid;
+        blocked_goal.set_blocked(goal_x, goal_y, true);
+        SearchContext forward, backward;
+        std::vector<std::size_t> both_path;
+        for (const occupancy_grid* grid : {&map_grid, &blocked_goal})
+        {
+            bool one_way = AStar::get_path(*grid, forward, query, both_path);
+            bool both_ends = BidirectionalAStar::get_path(*grid, forward, backward, query, both_path);
+            std::cout << (grid == &blocked_goal ? "bidirectional, goal blocked: " : "bidirectional: ") << (both_ends ? "found, " : "no path, ")
+                      << (both_ends == one_way ? "same as" : "differs from") << " the one-way search" << std::endl;
+        }
+    }
+
+    // incremental mode: drop an obstacle on the path, repair the search, then clear it again
+    if (found && path.size() > 2)
+    {
+        query.direction = start_dir;
+        query.heuristic = heuristic_mode::euclidean;
+        IncrementalPlanner incremental(std::shared_ptr<occupancy_grid>(&map_grid, [](occupancy_grid*) {}));
+        incremental.plan(query, path);
+        std::size_t cell = path[path.size() / 2];
+        for (bool blocked : {true, false})
+        {
+            incremental.set_blocked(map_grid.cell_x(cell), map_grid.cell_y(cell), blocked);
+            bool repaired = incremental.replan(path);
+            std::cout << (blocked ? "blocked " : "cleared ") << "(" << map_grid.cell_x(cell) << ", " << map_grid.cell_y(cell) << "), map version "
+                      << incremental.map_version() << ": " << (repaired ? "found, " : "no path, ") << incremental.last_expansions()
+                      << " states re-expanded of " << incremental.search().expansions << std::endl;
+        }
+    }
+
+    // anytime mode: a quick inflated-heuristic path first, improved in small expansion budgets
+    query.direction = start_dir;
+    query.heuristic = heuristic_mode::euclidean;
+    AnytimeAStar anytime;
+    bool improving = anytime.plan(map_grid, query, search_budget::expansions(25), path);
+    while (true)
+    {
+        std::cout << "anytime, " << anytime.passes() << " passes, weight " << anytime.weight() << ": " << (improving ? "cost " : "no path yet");
+        if (improving)
+            std::cout << anytime.cost() << ", bound " << anytime.bound();
+        std::cout << ", " << anytime.search().expansions << " states expanded" << std::endl;
+        if (anytime.done())
+            break;
+        improving = anytime.improve(map_grid, search_budget::expansions(25), path);
+    }
+
+    // time-sliced mode: the same query, 30 expansions per step as a frame loop would run it
+    SearchTask task;
+    task.start(map_grid, query);
+    for (int frame = 1; task.step(map_grid, 30) == search_status::running; frame++)
+    {
+        search_progress progress = task.progress();
+        std::cout << "frame " << frame << ": " << progress.expansions << " states expanded, " << progress.frontier
+                  << " open, closest " << progress.closest << " from the goal" << std::endl;
+    }
+    std::cout << "time-sliced search " << (task.status() == search_status::found ? "found a path of cost " : "found no path, cost ")
+              << task.search().path_cost << std::endl;
     std::cout << "EXIT NOW" << std::endl;
     return 0;
 }
\ No newline at end of file
@@ -1,407 +1,921 @@
 
+#pragma once
 #include <vector>
 #include <math.h>
 #include <queue>
-#include <unordered_set>
+#include <algorithm>
+#include <memory>
+#include "occupancy_grid.h"
+#include "geometry.h"
+#include "heuristic.h"
+#include "successor_kernel.h"
+#include "search_stats.h"
+#include "search_trace.h"
+#include "open_list.h"
+#include "motion_table.h"
+#include "clearance.h"
+
+// A search state in its working form: successors are built as path_nodes and only the ones
+// kept are packed into a SearchContext's state pool. direction is always decode_heading(heading),
+// so the stored state and the bin computed from the candidate agree.
+class path_node
+{
+public:
+    vector2d position;
+    vector2d direction;
+    int x = 0, y = 0; // grid cell containing this state
+    state_id previous = no_state;
+    float g = 0;     // path length from the start
+    float cost = -1; // g plus the heuristic estimate to the goal
+    std::uint16_t heading = 0;
+    path_node() {}
+    path_node(vector2d pos, std::uint16_t fixed_heading, int cell_x, int cell_y)
+        : position(pos), direction(decode_heading(fixed_heading)), x(cell_x), y(cell_y), heading(fixed_heading)
+    {
+    }
+    path_node(vector2d pos, vector2d dir, std::uint16_t fixed_heading, int cell_x, int cell_y)
+        : position(pos), direction(dir), x(cell_x), y(cell_y), heading(fixed_heading)
+    {
+    }
+};
+
+// A state as stored in the pool: 16 bytes. The cell is (int(x), int(y)), as it was for the
+// float position the state was built from; g and cost live in arrays of their own.
+struct packed_state
+{
+    float x = 0, y = 0;
+    state_id previous = no_state;
+    std::uint16_t heading = 0;
+    std::uint16_t previous_pool = 0; // pool holding previous, for searches spanning several (ParallelAStar)
+};
+static_assert(sizeof(packed_state) == 16, "packed_state should stay at 16 bytes");
+
+extern occupancy_grid map_grid;
+
+// Limits a search to the cells [x0, x1) x [y0, y1) and, when allowed is set, to the
+// cluster_size x cluster_size tiles flagged in it (row-major, columns tiles per row).
+struct search_region
+{
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+    int cluster_size = 1;
+    int columns = 0;
+    const std::uint8_t* allowed = nullptr;
+
+    inline bool contains(int x, int y) const
+    {
+        if (x < x0 || x >= x1 || y < y0 || y >= y1)
+            return false;
+        return allowed == nullptr || allowed[std::size_t(y / cluster_size) * columns + x / cluster_size] != 0;
+    }
+};
+
+// One planning request: start pose, goal cell and the minimum turning radius.
+struct Query
+{
+    vector2d start;
+    vector2d direction;
+    int goal_x = 0, goal_y = 0;
+    float radius = 1;
+    heuristic_mode heuristic = heuristic_mode::euclidean;
+    const search_region* region = nullptr; // optional, the whole grid when null
+    const motion_table* motions = nullptr; // optional successor table built for radius, exact geometry when null
+    const collision_checker* collision = nullptr; // optional vehicle footprint, a point agent when null
+    bool hierarchical = false; // Planner only: route through its ClusterHierarchy for radius
+    bool bidirectional = false; // Planner only: search from both ends (BidirectionalAStar)
+};
+
+// One goal of a multi-goal search (AStar::get_paths): the caller sets the cell, the search
+// fills in the rest.
+struct goal_path
+{
+    int goal_x = 0, goal_y = 0;
+    bool found = false;
+    float cost = 0; // path length, valid when found
+    std::vector<std::size_t> path; // cell indices from this goal back to the start
+};
 
-class vector2d
+// Closed set over a discretized state lattice: each cell is split into (entry edge, offset
+// along that edge, heading) bins, so a cell first reached with a poor heading does not block
+// later arrivals with a better one. Storage is tiled: a tile of tile_size x tile_size cells
+// gets a block of words_per_cell words per cell the first time a query closes a state in it,
+// and a per-tile generation stamp retires every block at the next reset. Memory follows the
+// area a query explores, not the map size.
+class state_lattice
 {
 public:
-    float x, y;
-    vector2d() : x(0), y(0) {}
-    vector2d(float a, float b) : x(a), y(b) {}
+    static constexpr int tile_shift = 6; // tiles of 64 x 64 cells
+    static constexpr int tile_size = 1 << tile_shift;
+    static constexpr int tile_cells = tile_size * tile_size;
 
-    // basic operations
+    int heading_bins = 32;
+    int offset_bins = 1; // sub-positions per cell edge
+    int bins_per_cell = 64;
+    int words_per_cell = 1;
 
-    vector2d operator+(const vector2d& other) const
+    inline void configure(int headings, int offsets)
     {
-        return vector2d(x + other.x, y + other.y);
+        heading_bins = headings < 1 ? 1 : headings;
+        offset_bins = offsets < 1 ? 1 : offsets;
+        bins_per_cell = 4 * offset_bins * heading_bins;
+        words_per_cell = (bins_per_cell + 63) / 64;
+        tile_columns = tile_rows = 0;
+        tile_stamp.clear();
+        tile_block.clear();
+        blocks.clear();
     }
-    vector2d operator-(const vector2d& other) const
+
+    // Starts a new query on a width x height map. O(1) unless the map's tile count changed.
+    inline void reset(int width, int height)
     {
-        return vector2d(x - other.x, y - other.y);
+        int columns = (width + tile_size - 1) >> tile_shift;
+        int rows = (height + tile_size - 1) >> tile_shift;
+        if (columns != tile_columns || rows != tile_rows)
+        {
+            tile_columns = columns;
+            tile_rows = rows;
+            tile_stamp.assign(std::size_t(columns) * std::size_t(rows), 0);
+            tile_block.assign(tile_stamp.size(), 0);
+            generation = 0;
+        }
+        if (++generation == 0) // stamps wrapped around, forget every old mark once
+        {
+            std::fill(tile_stamp.begin(), tile_stamp.end(), 0);
+            generation = 1;
+        }
+        blocks_used = 0;
     }
-    vector2d operator*(float scalar) const
+
+    // Bin of a state inside its cell (x, y).
+    inline int bin(const vector2d& position, const vector2d& direction, int x, int y) const
     {
-        return vector2d(x * scalar, y * scalar);
+        return cell_bin(position, x, y) * heading_bins + heading_bin(direction);
     }
-    vector2d operator/(float scalar) const
+    inline int bin(const vector2d& position, std::uint16_t heading, int x, int y) const
     {
-        return vector2d(x / scalar, y / scalar);
+        return cell_bin(position, x, y) * heading_bins + heading_bin(heading);
     }
-    bool operator==(const vector2d& other) const
+    // Entry edge and offset part of a bin, in [0, 4 * offset_bins).
+    inline int cell_bin(const vector2d& position, int x, int y) const
     {
-        return x == other.x && y == other.y;
+        float fx = position.x - x;
+        float fy = position.y - y;
+        // nearest cell edge: 0 left, 1 right, 2 top, 3 bottom
+        int edge = 0;
+        float best = fx;
+        float offset = fy;
+        if (1 - fx < best) { best = 1 - fx; edge = 1; }
+        if (fy < best) { best = fy; edge = 2; offset = fx; }
+        if (1 - fy < best) { edge = 3; offset = fx; }
+        if (edge == 1) offset = fy;
+        int offset_bin = int(offset * offset_bins);
+        offset_bin = offset_bin < 0 ? 0 : (offset_bin >= offset_bins ? offset_bins - 1 : offset_bin);
+        return edge * offset_bins + offset_bin;
     }
-    bool operator!=(const vector2d& other) const
+    // Heading part of a bin, in [0, heading_bins). Bins are centred on the axis directions so
+    // straight runs along rows and columns do not straddle a bin boundary.
+    inline int heading_bin(const vector2d& direction) const
     {
-        return !(*this == other);
+        float angle = atan2f(direction.y, direction.x);
+        int b = int((angle + float(M_PI)) * heading_bins / float(2 * M_PI) + 0.5f);
+        return b >= heading_bins ? b - heading_bins : b;
+    }
+    // The same bin from a fixed-point heading (see encode_heading), in integer arithmetic.
+    inline int heading_bin(std::uint16_t heading) const
+    {
+        std::uint32_t turn = (std::uint32_t(heading) + 32768) & 0xffff; // angle + pi
+        int b = int((turn * std::uint32_t(heading_bins) + 32768) >> 16);
+        return b >= heading_bins ? b - heading_bins : b;
+    }
+    // Unit direction at the centre of heading bin b.
+    inline vector2d heading_direction(int b) const
+    {
+        float angle = float(b) * float(2 * M_PI) / heading_bins - float(M_PI);
+        return vector2d(cosf(angle), sinf(angle));
     }
 
-
-    // math functions
-
-    inline float magnitude() const
+    // True if any state of the cell (x, y) was closed during the current query.
+    inline bool touched(int x, int y) const
     {
-        return sqrt(x * x + y * y);
+        const std::uint64_t* words = cell_words(x, y);
+        if (words == nullptr)
+            return false;
+        for (int i = 0; i < words_per_cell; i++)
+            if (words[i] != 0)
+                return true;
+        return false;
     }
-    inline vector2d normalize() const
+    inline bool test(int x, int y, int b) const
     {
-        float mag = magnitude();
-        return vector2d(x / mag, y / mag);
+        const std::uint64_t* words = cell_words(x, y);
+        return words != nullptr && ((words[b >> 6] >> (b & 63)) & 1);
     }
-    inline float dot(const vector2d& other) const
+    inline void set(int x, int y, int b)
     {
-        return x * other.x + y * other.y;
+        std::size_t tile = tile_index(x, y);
+        if (tile_stamp[tile] != generation)
+        {
+            std::size_t block_words = std::size_t(tile_cells) * words_per_cell;
+            if ((blocks_used + 1) * block_words > blocks.size())
+                blocks.resize((blocks_used + 1) * block_words);
+            std::fill_n(blocks.begin() + blocks_used * block_words, block_words, 0);
+            tile_block[tile] = std::uint32_t(blocks_used++);
+            tile_stamp[tile] = generation;
+        }
+        std::uint64_t* words = &blocks[word_offset(tile, x, y)];
+        words[b >> 6] |= std::uint64_t(1) << (b & 63);
+    }
+    inline void clear(int x, int y, int b)
+    {
+        std::size_t tile = tile_index(x, y);
+        if (tile_stamp[tile] == generation)
+            blocks[word_offset(tile, x, y) + (b >> 6)] &= ~(std::uint64_t(1) << (b & 63));
     }
-    inline vector2d crossproduct(const vector2d& other) const
+
+    // Tiles that have closed states in the current query.
+    inline std::size_t tiles_used() const
     {
-        return vector2d(y * other.x - x * other.y, x * other.y - y * other.x);
+        return blocks_used;
     }
-    inline vector2d perpendicular(int mode) const
+    inline std::size_t memory_bytes() const
     {
-        if (mode == 0) // right
-            return vector2d(y, -x);
-        else // left
-            return vector2d(-y, x);
+        return tile_stamp.capacity() * sizeof(std::uint32_t) + tile_block.capacity() * sizeof(std::uint32_t) + blocks.capacity() * sizeof(std::uint64_t);
     }
 
-};
+private:
+    int tile_columns = 0, tile_rows = 0;
+    std::vector<std::uint32_t> tile_stamp; // generation that last materialized each tile
+    std::vector<std::uint32_t> tile_block; // block index of each tile, valid when stamped
+    std::vector<std::uint64_t> blocks;     // tile_cells * words_per_cell words per block
+    std::size_t blocks_used = 0;
+    std::uint32_t generation = 0;
 
-class obstacle
-{
-public:
-    int x, y, width, height;
-    obstacle() : x(0), y(0), width(1), height(1) {}
-    obstacle(int a, int b, int c, int d) : x(a), y(b), width(c), height(d) {}
+    inline std::size_t tile_index(int x, int y) const
+    {
+        return std::size_t(y >> tile_shift) * std::size_t(tile_columns) + std::size_t(x >> tile_shift);
+    }
+    inline std::size_t word_offset(std::size_t tile, int x, int y) const
+    {
+        std::size_t local = std::size_t(((y & (tile_size - 1)) << tile_shift) | (x & (tile_size - 1)));
+        return (std::size_t(tile_block[tile]) * tile_cells + local) * std::size_t(words_per_cell);
+    }
+    inline const std::uint64_t* cell_words(int x, int y) const
+    {
+        std::size_t tile = tile_index(x, y);
+        return tile_stamp[tile] == generation ? &blocks[word_offset(tile, x, y)] : nullptr;
+    }
 };
 
-class node
+// Owns every allocation a query needs: the pool of path states, the frontier, the table of
+// open states per lattice bin and the closed set. The pool is a list of fixed-size chunks,
+// each a structure of arrays: 16-byte packed_states (position, fixed-point heading, 32-bit
+// parent id) next to separate g and cost arrays, so a state costs 24 bytes and the frontier
+// and tables refer to states by id. reset() is O(1): the pool rewinds, the frontier is cleared
+// (its capacity is kept) and the open table and closed set are invalidated by bumping their
+// generation stamps, so after the first few queries a context performs no heap allocations
+// at all. Nothing is sized by the map's cell count, only by its tile count and the area a
+// query explores.
+class SearchContext
 {
 public:
-    int x, y;
-    vector2d agent_internal_position;
-    vector2d agent_internal_direction = vector2d(0, 1); // facing down initially
-    float cost = -1;
-    static node* goal_node;
-    node* previous = nullptr;
-    std::vector<node*> neighbors;
-    std::vector<node*> a_star_neighbors;
-    inline void set_cost(node* b) //const
-    { 
-        float new_b_cost = b->cost + distance(this, b) + distance(b, goal_node);
-        if (b->cost == -1 || b->cost > new_b_cost)
-        {
-            b->cost = new_b_cost;
-            b->previous = this;
-        }
-    }
-    inline static float distance(const node* a, const node* b)
+    static constexpr std::size_t chunk_size = 4096; // states per pool chunk
+
+    open_list frontier; // cheapest cost first; see open_list.h for the variants
+    state_lattice closed;
+    // Keep at most one open state per lattice bin: a cheaper arrival updates the open state in
+    // place (decrease-key) and a dearer one is dropped, so the frontier holds no duplicates.
+    // Searches that need states to stay as created (IncrementalPlanner) turn this off.
+    bool merge_duplicates = true;
+    // Expanded states by (cell, heading bin), for searches that join two frontiers
+    // (BidirectionalAStar); AStar itself leaves it empty.
+    open_table expanded_states;
+    // Let a closed lattice bin be expanded again when a cheaper arrival turns up (AnytimeAStar):
+    // a successor is kept only if it beats the cheapest state seen in its bin, and one that
+    // improves a bin already closed goes to inconsistent instead of the frontier.
+    bool reexpand_improved = false;
+    std::vector<state_id> inconsistent;
+    std::size_t expansions = 0;    // states expanded by the last query
+    std::size_t peak_frontier = 0; // largest frontier size seen by the last query
+    float path_cost = 0;           // length of the last path found
+    vector2d path_position;        // pose at the end of the last path found
+    vector2d path_direction;
+    search_stats stats;            // only filled in when built with ASTAR_STATS
+#if ASTAR_TRACE
+    search_trace* trace = nullptr; // records each query's expansions and path when set
+#endif
+
+    // heading_bins sets the angular resolution of the closed set, offset_bins the number of
+    // entry sub-positions per cell edge.
+    SearchContext(int heading_bins = 32, int offset_bins = 1)
     {
-        return sqrt(pow(b->x - a->x, 2) + pow(b->y - a->y, 2));
+        closed.configure(heading_bins, offset_bins);
     }
 
-    // special FOV functions
-    // Stack Overflow
-    inline int segmentCircleIntersection(const vector2d& p1, const vector2d& p2, const vector2d& center, float radius, vector2d out[2])
+    inline void reset(int width, int height)
     {
-        vector2d d = p2 - p1;
-        vector2d f = p1 - center;
-
-        float a = d.dot(d);
-        float b = 2 * f.dot(d);
-        float c = f.dot(f) - radius * radius;
+        used = 0;
+        map_width = width;
+        expansions = 0;
+        peak_frontier = 0;
+        path_cost = 0;
+        path_position = vector2d();
+        path_direction = vector2d();
+        stats = search_stats();
+        ASTAR_TRACE_EVENT(if (trace != nullptr) trace->begin(width, height);)
+        frontier.clear();
+        open_states.clear();
+        expanded_states.clear();
+        best_states.clear();
+        inconsistent.clear();
+        closed.reset(width, height);
+    }
 
-        float disc = b*b - 4*a*c;
-        if (disc < 0)
-            return 0;
+    // Empties the frontier, the open-state table and the closed set but keeps every state and
+    // the cheapest state per bin, so a search can run another pass over what it has already
+    // generated. Collect the states to carry over from frontier and inconsistent first.
+    inline void restart_pass(int width, int height)
+    {
+        frontier.clear();
+        open_states.clear();
+        inconsistent.clear();
+        closed.reset(width, height);
+    }
 
-        disc = sqrtf(disc);
-        float t1 = (-b - disc) / (2*a);
-        float t2 = (-b + disc) / (2*a);
+    // state pool
 
-        int count = 0;
+    // Packs n into the pool and returns its id.
+    inline state_id add_state(const path_node& n)
+    {
+        if (used == chunks.size() * chunk_size)
+            chunks.emplace_back(new state_chunk);
+        state_id i = state_id(used++);
+        set_state(i, n);
+        return i;
+    }
+    // Drops every state from id count on, keeping their chunks for reuse. None of them may still
+    // be in the frontier or the open-state tables.
+    inline void truncate_states(std::size_t count)
+    {
+        used = count < used ? count : used;
+    }
+    // The start state of a query: g 0 and the given cost, no previous state.
+    inline state_id add_start(const vector2d& position, const vector2d& direction, float cost)
+    {
+        path_node n(position, encode_heading(direction), int(position.x), int(position.y));
+        n.cost = cost;
+        return add_state(n);
+    }
+    // Overwrites state i with n (same cell and bin), e.g. when a cheaper arrival replaces an
+    // open state.
+    inline void set_state(state_id i, const path_node& n)
+    {
+        state_chunk& c = *chunks[i / chunk_size];
+        packed_state& s = c.states[i % chunk_size];
+        s.x = n.position.x;
+        s.y = n.position.y;
+        s.previous = n.previous;
+        s.previous_pool = 0;
+        s.heading = n.heading;
+        c.g[i % chunk_size] = n.g;
+        c.cost[i % chunk_size] = n.cost;
+    }
+    // State i unpacked.
+    inline path_node node(state_id i) const
+    {
+        const packed_state& s = packed(i);
+        path_node n(vector2d(s.x, s.y), s.heading, int(s.x), int(s.y));
+        n.previous = s.previous;
+        n.g = g(i);
+        n.cost = cost(i);
+        return n;
+    }
+    inline vector2d position(state_id i) const
+    {
+        return vector2d(packed(i).x, packed(i).y);
+    }
+    inline vector2d direction(state_id i) const
+    {
+        return decode_heading(packed(i).heading);
+    }
+    inline int cell_x(state_id i) const
+    {
+        return int(packed(i).x);
+    }
+    inline int cell_y(state_id i) const
+    {
+        return int(packed(i).y);
+    }
+    inline float g(state_id i) const
+    {
+        return chunks[i / chunk_size]->g[i % chunk_size];
+    }
+    inline float cost(state_id i) const
+    {
+        return chunks[i / chunk_size]->cost[i % chunk_size];
+    }
+    inline void set_cost(state_id i, float cost)
+    {
+        chunks[i / chunk_size]->cost[i % chunk_size] = cost;
+    }
+    inline state_id previous(state_id i) const
+    {
+        return packed(i).previous;
+    }
+    inline std::uint16_t previous_pool(state_id i) const
+    {
+        return packed(i).previous_pool;
+    }
+    inline void set_previous(state_id i, state_id previous, std::uint16_t pool = 0)
+    {
+        packed_state& s = chunks[i / chunk_size]->states[i % chunk_size];
+        s.previous = previous;
+        s.previous_pool = pool;
+    }
 
-        if (t1 >= 0.0f && t1 <= 1.0f) {
-            out[count++] = p1 + d * t1;
-        }
-        if (t2 >= 0.0f && t2 <= 1.0f && disc != 0.0f) {
-            out[count++] = p1 + d * t2;
-        }
+    // frontier
 
-        return count;
+    inline void push(state_id i)
+    {
+        ASTAR_STAT(stats.heap_pushes++;)
+        frontier.push(i, cost(i));
+        if (frontier.size() > peak_frontier)
+            peak_frontier = frontier.size();
     }
-
-    inline std::vector<vector2d> nodeCircleIntersections2(const node* n, const vector2d& circle_center, float circle_radius)
+    inline state_id pop()
     {
-        std::vector<vector2d> intersections;
-
-        // Define voxel corners (node is 1×1 tile)
-        vector2d p1 = { float(n->x),     float(n->y)     };
-        vector2d p2 = { float(n->x + 1), float(n->y)     };
-        vector2d p3 = { float(n->x + 1), float(n->y + 1) };
-        vector2d p4 = { float(n->x),     float(n->y + 1) };
+        ASTAR_STAT(stats.heap_pops++;)
+        return frontier.pop();
+    }
+    // i is open and its cost was just lowered from old_cost.
+    inline void decrease(state_id i, float old_cost)
+    {
+        ASTAR_STAT(stats.decrease_keys++;)
+        frontier.decrease(i, cost(i), old_cost);
+    }
 
-        vector2d out[2];
+    // open states, when merging duplicates; a bin's entry is dropped when the bin closes
 
-        // Edge 1: p1 → p2
-        int c = segmentCircleIntersection(p1, p2, circle_center, circle_radius, out);
-        for (int i = 0; i < c; i++) intersections.push_back(out[i]);
+    inline state_id find_open(std::size_t cell, int bin) const
+    {
+        return open_states.find(std::uint64_t(cell) * closed.bins_per_cell + bin);
+    }
+    inline void set_open(std::size_t cell, int bin, state_id i)
+    {
+        open_states.insert(std::uint64_t(cell) * closed.bins_per_cell + bin, i);
+    }
 
-        // Edge 2: p2 → p3
-        c = segmentCircleIntersection(p2, p3, circle_center, circle_radius, out);
-        for (int i = 0; i < c; i++) intersections.push_back(out[i]);
+    // cheapest state per bin, when reexpanding improved bins
 
-        // Edge 3: p3 → p4
-        c = segmentCircleIntersection(p3, p4, circle_center, circle_radius, out);
-        for (int i = 0; i < c; i++) intersections.push_back(out[i]);
+    inline state_id find_best(std::size_t cell, int bin) const
+    {
+        return best_states.find(std::uint64_t(cell) * closed.bins_per_cell + bin);
+    }
+    inline void set_best(std::size_t cell, int bin, state_id i)
+    {
+        best_states.insert(std::uint64_t(cell) * closed.bins_per_cell + bin, i);
+    }
 
-        // Edge 4: p4 → p1
-        c = segmentCircleIntersection(p4, p1, circle_center, circle_radius, out);
-        for (int i = 0; i < c; i++) intersections.push_back(out[i]);
+    // closed set
 
-        return intersections;
+    // Lattice bin of a state in cell (x, y).
+    inline int bin(const vector2d& position, const vector2d& direction, int x, int y) const
+    {
+        return closed.bin(position, direction, x, y);
+    }
+    inline int bin(state_id i) const
+    {
+        const packed_state& s = packed(i);
+        return closed.bin(vector2d(s.x, s.y), s.heading, int(s.x), int(s.y));
+    }
+    inline bool is_closed(int x, int y, int bin) const
+    {
+        return closed.test(x, y, bin);
+    }
+    // Marks the state closed and drops its bin from the open states; returns false if its
+    // lattice bin was already closed.
+    inline bool close(state_id i)
+    {
+        int x = cell_x(i), y = cell_y(i), b = bin(i);
+        if (closed.test(x, y, b))
+            return false;
+        closed.set(x, y, b);
+        if (open_states.size() != 0)
+            open_states.erase((std::uint64_t(y) * std::uint64_t(map_width) + std::uint64_t(x)) * closed.bins_per_cell + b);
+        return true;
+    }
+    // Undoes close(i), so the bin can be expanded again.
+    inline void reopen(state_id i)
+    {
+        closed.clear(cell_x(i), cell_y(i), bin(i));
+    }
+    // True if the last query expanded any state in the cell.
+    inline bool visited(int x, int y) const
+    {
+        return closed.touched(x, y);
     }
 
+    inline std::size_t states_used() const
+    {
+        return used;
+    }
+    inline std::size_t memory_bytes() const
+    {
+        return chunks.size() * sizeof(state_chunk) + frontier.memory_bytes() + open_states.memory_bytes() + expanded_states.memory_bytes() + best_states.memory_bytes() + inconsistent.capacity() * sizeof(state_id) + closed.memory_bytes();
+    }
 
+private:
+    open_table open_states;
+    open_table best_states;
+    struct state_chunk
+    {
+        packed_state states[chunk_size];
+        float g[chunk_size];
+        float cost[chunk_size];
+    };
+    std::vector<std::unique_ptr<state_chunk>> chunks;
+    std::size_t used = 0;
+    int map_width = 0; // of the current query, for open-table keys
+
+    inline const packed_state& packed(state_id i) const
+    {
+        return chunks[i / chunk_size]->states[i % chunk_size];
+    }
 };
 
-class path_node
+// The search is generic over the map type: any Grid with occupancy_grid's width, height,
+// in_bounds, blocked and index members works, e.g. occupancy_grid or chunked_grid.
+class AStar
 {
 public:
-    vector2d position;
-    vector2d direction;
-    node* parent_node = nullptr;
-    path_node* previous = nullptr;
-    std::vector<path_node*> neighbors;
-    float cost = -1;
-    path_node(vector2d pos, vector2d dir, node* parent) : position(pos), direction(dir), parent_node(parent) {}
-
-    inline void set_other_cost(path_node* b)
+    // Fills path with the cell indices (see occupancy_grid::index) from goal back to start.
+    // Returns false when the goal cannot be reached. Only reads grid and writes context, so
+    // queries on separate contexts can run concurrently. A dubins heuristic must be built
+    // for query.radius.
+    template <class Grid>
+    inline static bool get_path(const Grid& grid, SearchContext& context, const Query& query, std::vector<std::size_t>& path, const heuristic& h = heuristic())
     {
-        if (cost == -1)
+        const int goal_x = query.goal_x, goal_y = query.goal_y;
+        context.reset(grid.width, grid.height);
+        ASTAR_TRACE_EVENT(if (context.trace != nullptr) context.trace->set_goal(goal_x, goal_y);)
+        path.clear();
+        if (!valid_query(grid, query))
+            return false;
+        context.push(context.add_start(query.start, query.direction, h.estimate(query.start, query.direction, goal_x, goal_y)));
+        auto estimate = [&](const path_node& n) { return h.estimate(n.position, n.direction, goal_x, goal_y); };
+        while (context.frontier.size() > 0 && (context.cell_x(context.frontier.front()) != goal_x || context.cell_y(context.frontier.front()) != goal_y))
         {
-            cost = 0;
+            expand(grid, context, query, estimate);
         }
-        float new_b_cost = cost + (position - b->position).magnitude() + (b->position - vector2d(node::goal_node->x, node::goal_node->y)).magnitude();
-        if (b->cost == -1 || b->cost > new_b_cost)
+        ASTAR_STAT(context.stats.nodes_expanded = context.expansions; context.stats.peak_frontier = context.peak_frontier;)
+        if (context.frontier.size() == 0)
         {
-            b->cost = new_b_cost;
-            b->previous = this;
+            return false;
         }
+        trace_path(grid, context, context.frontier.front(), path);
+        return true;
     }
 
-    inline std::vector<vector2d> nodeCircleIntersections(const path_node* n, const vector2d& circle_center, float circle_radius)
+    // Whether query can be searched on grid: its start lies inside the map on a free cell and,
+    // with_goal, its goal cell is a free cell inside the map. Every search entry point checks this
+    // before creating any state and answers a query that fails it as not found.
+    template <class Grid>
+    inline static bool valid_query(const Grid& grid, const Query& query, bool with_goal = true)
     {
-        std::vector<vector2d> intersections;
-
-        // Define voxel corners (node is 1×1 tile)
-        vector2d p1 = { float(parent_node->x),     float(parent_node->y)     };
-        vector2d p2 = { float(parent_node->x + 1), float(parent_node->y)     };
-        vector2d p3 = { float(parent_node->x + 1), float(parent_node->y + 1) };
-        vector2d p4 = { float(parent_node->x),     float(parent_node->y + 1) };
-
-        vector2d out[2];
-
-        // Edge 1: p1 → p2
-        int c = parent_node->segmentCircleIntersection(p1, p2, circle_center, circle_radius, out);
-        for (int i = 0; i < c; i++) intersections.push_back(out[i]);
-
-        // Edge 2: p2 → p3
-        c = parent_node->segmentCircleIntersection(p2, p3, circle_center, circle_radius, out);
-        for (int i = 0; i < c; i++) intersections.push_back(out[i]);
-
-        // Edge 3: p3 → p4
-        c = parent_node->segmentCircleIntersection(p3, p4, circle_center, circle_radius, out);
-        for (int i = 0; i < c; i++) intersections.push_back(out[i]);
-
-        // Edge 4: p4 → p1
-        c = parent_node->segmentCircleIntersection(p4, p1, circle_center, circle_radius, out);
-        for (int i = 0; i < c; i++) intersections.push_back(out[i]);
-
-        return intersections;
+        const vector2d& s = query.start;
+        if (!(s.x >= 0 && s.y >= 0 && s.x < float(grid.width) && s.y < float(grid.height)))
+            return false;
+        if (grid.blocked(int(s.x), int(s.y)))
+            return false;
+        return !with_goal || (grid.in_bounds(query.goal_x, query.goal_y) && !grid.blocked(query.goal_x, query.goal_y));
     }
 
-    // Helper function to find intersection between two line segments
-    inline bool segmentSegmentIntersection(const vector2d& p1, const vector2d& p2, 
-                                        const vector2d& p3, const vector2d& p4, 
-                                        vector2d& out)
+    // Fills path with the cells from goal back to the start and records the path's cost and
+    // final pose in context.
+    template <class Grid>
+    inline static void trace_path(const Grid& grid, SearchContext& context, state_id goal, std::vector<std::size_t>& path)
     {
-        vector2d s1 = p2 - p1;
-        vector2d s2 = p4 - p3;
-        
-        float denom = (-s2.x * s1.y + s1.x * s2.y);
-        if (fabs(denom) < 1e-6) return false; // Parallel or collinear
-        
-        float s = (-s1.y * (p1.x - p3.x) + s1.x * (p1.y - p3.y)) / denom;
-        float t = ( s2.x * (p1.y - p3.y) - s2.y * (p1.x - p3.x)) / denom;
-        
-        if (s >= 0.0f && s <= 1.0f && t >= 0.0f && t <= 1.0f)
+        path.clear();
+        context.path_cost = context.g(goal);
+        context.path_position = context.position(goal);
+        context.path_direction = context.direction(goal);
+        for (state_id step = goal; step != no_state; step = context.previous(step))
         {
-            out = p1 + s1 * t;
-            return true;
+            path.push_back(grid.index(context.cell_x(step), context.cell_y(step)));
+            ASTAR_TRACE_EVENT(if (context.trace != nullptr) context.trace->add(trace_kind::path, context.position(step), context.node(step).heading, context.g(step));)
         }
-        
-        return false;
     }
 
-    inline std::vector<vector2d> nodeLineIntersections(const path_node* n, float line_length)
-    {
-        std::vector<vector2d> intersections;
-        
-        // Create line from current position in the direction we're facing
-        vector2d line_start = n->position;
-        vector2d line_end = n->position + (n->direction * line_length);
-        
-        // Define voxel corners (node is 1×1 tile)
-        vector2d p1 = { float(n->parent_node->x),     float(n->parent_node->y)     };
-        vector2d p2 = { float(n->parent_node->x + 1), float(n->parent_node->y)     };
-        vector2d p3 = { float(n->parent_node->x + 1), float(n->parent_node->y + 1) };
-        vector2d p4 = { float(n->parent_node->x),     float(n->parent_node->y + 1) };
-        
-        vector2d out;
-        
-        // Edge 1: p1 → p2
-        if (segmentSegmentIntersection(line_start, line_end, p1, p2, out))
-            intersections.push_back(out);
-        
-        // Edge 2: p2 → p3
-        if (segmentSegmentIntersection(line_start, line_end, p2, p3, out))
-            intersections.push_back(out);
-        
-        // Edge 3: p3 → p4
-        if (segmentSegmentIntersection(line_start, line_end, p3, p4, out))
-            intersections.push_back(out);
-        
-        // Edge 4: p4 → p1
-        if (segmentSegmentIntersection(line_start, line_end, p4, p1, out))
-            intersections.push_back(out);
-        
-        return intersections;
-    }
-};
-
-
-extern std::vector<std::vector<node*>> map_grid;
-extern std::vector<std::vector<node*>> fov_grid;
-
-class AStarComparator
-{
-public:
-    bool operator()(const path_node* a, const path_node* b) const
+    // Uninformed one-to-many search: from query's start pose, finds the cheapest arrival in each
+    // of the target cells (query's goal is ignored). costs[i] is set to the path length to
+    // targets[i], or -1 when it cannot be reached, and directions[i] to the heading on arrival.
+    // Stops once every target is reached, the reachable (region-limited) states run out or the
+    // cheapest open state costs more than max_cost.
+    template <class Grid>
+    inline static void get_costs(const Grid& grid, SearchContext& context, const Query& query, const std::size_t* targets, int target_count, float* costs, vector2d* directions, float max_cost = INFINITY)
     {
-        return a->cost > b->cost;
+        context.reset(grid.width, grid.height);
+        for (int i = 0; i < target_count; i++)
+            costs[i] = -1;
+        if (!valid_query(grid, query, false))
+            return;
+        context.push(context.add_start(query.start, query.direction, 0));
+        auto estimate = [](const path_node&) { return 0.0f; };
+        int remaining = target_count;
+        while (context.frontier.size() > 0 && remaining > 0)
+        {
+            state_id front = context.frontier.front();
+            if (context.g(front) > max_cost)
+                break;
+            std::size_t cell = grid.index(context.cell_x(front), context.cell_y(front));
+            for (int i = 0; i < target_count; i++)
+            {
+                if (targets[i] == cell && costs[i] < 0)
+                {
+                    costs[i] = context.g(front);
+                    directions[i] = context.direction(front);
+                    remaining--;
+                }
+            }
+            expand(grid, context, query, estimate);
+        }
     }
-};
 
-class AStar
-{
-public:
-    inline static std::vector<node*> get_path(path_node* start_pathnode, path_node* goal_pathnode, float radius)//?(node* start, node* goal)
+    // One search from query's start serving several goals (query's own goal is ignored). The
+    // heuristic is the minimum of h over the goals not reached yet, and the search keeps going
+    // through goal cells, so the expansion the goals share is done once. Each goal's path and
+    // cost are filled in when a state in its cell is first popped. Stops once max_found goals
+    // are reached (the nearest ones by path cost, up to the heuristic's slack inside a goal
+    // cell) or the frontier runs out, and returns how many were reached. Open states keep the
+    // estimate they were pushed with; dropping a goal can only raise the minimum, so they stay
+    // lower bounds.
+    template <class Grid>
+    inline static std::size_t get_paths(const Grid& grid, SearchContext& context, const Query& query, std::span<goal_path> goals, std::size_t max_found = SIZE_MAX, const heuristic& h = heuristic())
     {
-        std::priority_queue<path_node*, std::vector<path_node*>, AStarComparator> frontier;
-        std::unordered_set<node*> explored;
-        frontier.push(start_pathnode);
-        start_pathnode->cost = (start_pathnode->position - goal_pathnode->position).magnitude();
-        while (frontier.size() > 0 && frontier.top()->parent_node != node::goal_node)
+        context.reset(grid.width, grid.height);
+        std::vector<std::pair<std::size_t, std::size_t>> pending; // (cell, goal), sorted by cell
+        std::vector<std::size_t> remaining; // goals not reached yet, for the estimate
+        for (std::size_t i = 0; i < goals.size(); i++)
         {
-            path_node* current = frontier.top();
-            if (current->parent_node == nullptr)
-            {
-                frontier.pop();
+            goals[i].found = false;
+            goals[i].cost = 0;
+            goals[i].path.clear();
+            if (!grid.in_bounds(goals[i].goal_x, goals[i].goal_y))
                 continue;
+            pending.push_back({grid.index(goals[i].goal_x, goals[i].goal_y), i});
+            remaining.push_back(i);
+        }
+        if (!valid_query(grid, query, false) || remaining.empty())
+            return 0;
+        std::sort(pending.begin(), pending.end());
+        std::size_t target = std::min(max_found, remaining.size());
+        std::size_t found = 0;
+        std::size_t last_nearest = remaining.front(); // goal that was nearest last time; neighbouring states usually share it
+        auto nearest = [&](const vector2d& position, const vector2d& direction)
+        {
+            const goal_path& guess = goals[last_nearest];
+            float best = guess.found ? INFINITY : h.estimate(position, direction, guess.goal_x, guess.goal_y);
+            for (std::size_t i : remaining)
+            {
+                if (h.bound_squared(position, goals[i].goal_x, goals[i].goal_y) >= best * best)
+                    continue;
+                float e = h.estimate(position, direction, goals[i].goal_x, goals[i].goal_y);
+                if (e < best)
+                {
+                    best = e;
+                    last_nearest = i;
+                }
             }
-            // -- grid graphics -- //
-            if (current->position.y >= 0 && current->position.y < fov_grid.size() &&
-                current->position.x >= 0 && current->position.x < fov_grid[0].size())
+            return best;
+        };
+        auto estimate = [&](const path_node& n) { return nearest(n.position, n.direction); };
+        if (target > 0)
+            context.push(context.add_start(query.start, query.direction, nearest(query.start, query.direction)));
+        while (found < target && context.frontier.size() > 0)
+        {
+            state_id front = context.frontier.front();
+            std::size_t cell = grid.index(context.cell_x(front), context.cell_y(front));
+            auto first = std::lower_bound(pending.begin(), pending.end(), std::make_pair(cell, std::size_t(0)));
+            auto last = first;
+            for (; last != pending.end() && last->first == cell; ++last)
             {
-                fov_grid[int(current->position.y)][int(current->position.x)] = current->parent_node;
+                goal_path& goal = goals[last->second];
+                trace_path(grid, context, front, goal.path);
+                goal.found = true;
+                goal.cost = context.g(front);
+                remaining.erase(std::find(remaining.begin(), remaining.end(), last->second));
+                found++;
             }
-            // -- end grid graphics -- //
-            frontier.pop();
-            explored.insert(current->parent_node);
-            // get neighbors
-            vector2d circle_pos1 = current->position + (current->direction.perpendicular(0).normalize() * radius);
-            vector2d circle_pos2 = current->position + (current->direction.perpendicular(1).normalize() * radius);
-            auto intersections_1 = current->nodeCircleIntersections(current, circle_pos1, radius);
-            auto intersections_2 = current->nodeCircleIntersections(current, circle_pos2, radius);
-            auto line_intersections = current->nodeLineIntersections(current, 1.0f);
-
-            for (auto inter : intersections_1)
+            pending.erase(first, last);
+            if (found >= target)
+                break;
+            expand(grid, context, query, estimate);
+        }
+        ASTAR_STAT(context.stats.nodes_expanded = context.expansions; context.stats.peak_frontier = context.peak_frontier;)
+        return found;
+    }
+
+    // Convenience overload that runs on map_grid and a shared context; not safe to call from several threads.
+    inline static std::vector<std::size_t> get_path(path_node* start_pathnode, path_node* goal_pathnode, float radius)
+    {
+        static SearchContext context;
+        Query query;
+        query.start = start_pathnode->position;
+        query.direction = start_pathnode->direction;
+        query.goal_x = goal_pathnode->x;
+        query.goal_y = goal_pathnode->y;
+        query.radius = radius;
+        std::vector<std::size_t> path;
+        get_path(map_grid, context, query, path);
+        return path;
+    }
+
+    // Pops the best frontier state and, unless its lattice bin was already expanded, pushes its
+    // turning and straight successors. estimate(node) gives the heuristic for a new state.
+    // Public so searches that drive their own loop (IncrementalPlanner) share the expansion.
+    template <class Grid, class Estimate>
+    inline static void expand(const Grid& grid, SearchContext& context, const Query& query, const Estimate& estimate)
+    {
+        path_node successors[20]; // candidates, only packed into the pool when pushed
+        int bins[20];
+        ASTAR_STAT(std::uint64_t heap_start = search_stats::now_ns();)
+        state_id current = context.pop();
+        if (!context.close(current))
+        {
+            ASTAR_STAT(context.stats.duplicate_pushes++; context.stats.heap_ns += search_stats::now_ns() - heap_start;)
+            return; // a state in the same lattice bin was already expanded
+        }
+        context.expansions++;
+        ASTAR_TRACE_EVENT(if (context.trace != nullptr) context.trace->add(trace_kind::expanded, context.position(current), context.node(current).heading, context.g(current));)
+        ASTAR_STAT(std::uint64_t successor_start = search_stats::now_ns(); context.stats.heap_ns += successor_start - heap_start;)
+        int successor_count = generate_successors(grid, context, query, current, estimate, successors, bins);
+        ASTAR_STAT(std::uint64_t push_start = search_stats::now_ns(); context.stats.successor_ns += push_start - successor_start;)
+        for (int i = 0; i < successor_count; i++)
+        {
+            const path_node& s = successors[i];
+            std::size_t cell = grid.index(s.x, s.y);
+            if (context.reexpand_improved)
             {
-                vector2d new_dir = (inter - circle_pos1).normalize().perpendicular(0).normalize();
-                if (current->direction.dot(new_dir) <= 0)
+                state_id best = context.find_best(cell, bins[i]);
+                if (best != no_state && context.g(best) <= s.g)
                 {
-                    new_dir = new_dir * -1.0f;//(inter - circle_pos1).normalize().perpendicular(1).normalize();
+                    ASTAR_STAT(if (context.is_closed(s.x, s.y, bins[i])) context.stats.closed_set_hits++; else context.stats.merged_successors++;)
+                    continue;
                 }
-                inter = inter + new_dir * 0.01f; // nudge a bit to avoid sticking exactly on corners
-                if (int(inter.y) >= 0 && int(inter.y) < map_grid.size() &&
-                    int(inter.x) >= 0 && int(inter.x) < map_grid[0].size() && (inter - current->position).normalize().dot(current->direction) > 0)
+                if (context.is_closed(s.x, s.y, bins[i]))
                 {
-                    auto new_pathnode = new path_node(inter, new_dir, map_grid[int(inter.y)][int(inter.x)]);
-                    new_pathnode->previous = current;
-                    current->neighbors.push_back(new_pathnode);
+                    state_id n = context.add_state(s);
+                    context.inconsistent.push_back(n);
+                    context.set_best(cell, bins[i], n);
+                    continue;
                 }
             }
-
-            for (auto inter : intersections_2)
+            state_id open = context.merge_duplicates ? context.find_open(cell, bins[i]) : no_state;
+            if (open != no_state)
             {
-                vector2d new_dir = (inter - circle_pos2).normalize().perpendicular(1).normalize();
-                if (current->direction.dot(new_dir) <= 0)
+                float old_cost = context.cost(open);
+                if (old_cost <= s.cost)
                 {
-                    new_dir = new_dir * -1.0f;
-                }
-                inter = inter + new_dir * 0.01f; // nudge a bit to avoid sticking exactly on corners
-                if (int(inter.y) >= 0 && int(inter.y) < map_grid.size() &&
-                    int(inter.x) >= 0 && int(inter.x) < map_grid[0].size() && (inter - current->position).normalize().dot(current->direction) > 0)
-                {
-                    auto new_pathnode = new path_node(inter, new_dir, map_grid[int(inter.y)][int(inter.x)]);
-                    new_pathnode->previous = current;
-                    current->neighbors.push_back(new_pathnode);
+                    ASTAR_STAT(context.stats.merged_successors++;)
+                    continue;
                 }
+                // an open state has no successors yet, so it can take the cheaper arrival's place
+                context.set_state(open, s);
+                context.decrease(open, old_cost);
+                continue;
             }
+            state_id n = context.add_state(s);
+            context.push(n);
+            if (context.merge_duplicates)
+                context.set_open(cell, bins[i], n);
+            if (context.reexpand_improved)
+                context.set_best(cell, bins[i], n);
+        }
+        ASTAR_STAT(context.stats.heap_ns += search_stats::now_ns() - push_start;)
+    }
 
-            for (auto inter : line_intersections)
+    // Builds the turning and straight successors of state current in successors and bins (room
+    // for 20), with g and cost set, and returns how many there are. They come from
+    // query.motions when it is set for query.radius and covers the state. Public so searches
+    // that route successors elsewhere (ParallelAStar) share the geometry.
+    template <class Grid, class Estimate>
+    inline static int generate_successors(const Grid& grid, SearchContext& context, const Query& query, state_id current, const Estimate& estimate, path_node successors[], int bins[])
+    {
+        const float radius = query.radius;
+        const path_node from = context.node(current);
+        int successor_count = 0;
+        std::span<const motion_primitive> primitives;
+        if (query.motions != nullptr && query.motions->radius == radius && query.motions->lookup(from.position, from.heading, from.x, from.y, primitives))
+        {
+            for (const motion_primitive& p : primitives)
             {
-                vector2d new_dir = current->direction;
-                inter = inter + new_dir * 0.01f; // nudge a bit to avoid sticking exactly on corners
-                if (int(inter.y) >= 0 && int(inter.y) < map_grid.size() &&
-                    int(inter.x) >= 0 && int(inter.x) < map_grid[0].size() && (inter - current->position).normalize().dot(current->direction) > 0)
-                {
-                    auto new_pathnode = new path_node(inter, new_dir, map_grid[int(inter.y)][int(inter.x)]);
-                    new_pathnode->previous = current;
-                    current->neighbors.push_back(new_pathnode);
-                }
+                vector2d inter(float(from.x) + p.x, float(from.y) + p.y);
+                if (add_neighbor(grid, context, query, current, from, inter, vector2d(p.dx, p.dy), p.heading, p.kind, int(inter.x), int(inter.y), successors, bins, successor_count))
+                    successors[successor_count - 1].g = from.g + p.length;
             }
+            for (int i = 0; i < successor_count; i++)
+                successors[i].cost = successors[i].g + estimate(successors[i]);
+            return successor_count;
+        }
+
+        cell_crossings crossings;
+        // get neighbors
+        vector2d circle_pos[2];
+        circle_pos[0] = from.position + (from.direction.perpendicular(0).normalize() * radius);
+        circle_pos[1] = from.position + (from.direction.perpendicular(1).normalize() * radius);
+        cell_successor_crossings(from.x, from.y, from.position, from.direction, circle_pos, radius, 1.0f, crossings);
 
-            // explore neighbors
-            for (auto a_star_neighbor : current->neighbors)
+        for (int side = 0; side < 2; side++)
+        {
+            for (int i = 0; i < crossings.circle_count[side]; i++)
             {
-                if (explored.find(a_star_neighbor->parent_node) == explored.end())
+                vector2d inter = crossings.circle[side][i];
+                vector2d new_dir = (inter - circle_pos[side]).normalize().perpendicular(side).normalize();
+                if (from.direction.dot(new_dir) <= 0)
                 {
-                    current->set_other_cost(a_star_neighbor);
-                    frontier.push(a_star_neighbor);
+                    new_dir = new_dir * -1.0f;
                 }
+                inter = inter + new_dir * 0.01f; // nudge a bit to avoid sticking exactly on corners
+                std::uint16_t heading = encode_heading(new_dir);
+                if (ahead(context, from, inter))
+                    add_neighbor(grid, context, query, current, from, inter, decode_heading(heading), heading, side == 1 ? motion_kind::left : motion_kind::right, int(inter.x), int(inter.y), successors, bins, successor_count);
             }
         }
-        std::vector<node*> path;
-        if (frontier.top()->parent_node == node::goal_node)
+
+        for (int i = 0; i < crossings.line_count; i++)
         {
-            std::cout << "Path found!" << std::endl;
+            vector2d inter = crossings.line[i] + from.direction * 0.01f; // nudge a bit to avoid sticking exactly on corners
+            if (ahead(context, from, inter))
+                add_neighbor(grid, context, query, current, from, inter, from.direction, from.heading, motion_kind::straight, int(inter.x), int(inter.y), successors, bins, successor_count);
         }
-        else
+
+        // explore neighbors
+        for (int i = 0; i < successor_count; i++)
         {
-            std::cout << "No path found." << std::endl;
-            return path;
+            path_node& s = successors[i];
+            s.g = from.g + (from.position - s.position).magnitude();
+            s.cost = s.g + estimate(s);
         }
-        path_node* step = frontier.top();
-        while (step != nullptr)
+        return successor_count;
+    }
+
+private:
+    // False, counted as rejected, when inter lies behind the agent at from.
+    inline static bool ahead([[maybe_unused]] SearchContext& context, const path_node& from, const vector2d& inter)
+    {
+        if ((inter - from.position).normalize().dot(from.direction) <= 0)
         {
-            path.push_back(step->parent_node);
-            step = step->previous;
+            ASTAR_STAT(context.stats.rejected_backward++;)
+            return false;
         }
-        return path;
+        return true;
+    }
+
+    // Successors landing outside the map (or the query's region), in an obstacle, in an
+    // already expanded lattice bin or, with a query footprint, whose motion from the state at
+    // from collides are dropped here, before anything is added to the pool; returns whether
+    // the successor was kept. With reexpand_improved the closed bins are left to expand(),
+    // which knows the successor's cost.
+    template <class Grid>
+    inline static bool add_neighbor(const Grid& grid, SearchContext& context, const Query& query, state_id current, const path_node& from, const vector2d& inter, const vector2d& direction, std::uint16_t heading, motion_kind kind, int cell_x, int cell_y, path_node successors[], int bins[], int& successor_count)
+    {
+        const search_region* region = query.region;
+        if (!grid.in_bounds(cell_x, cell_y) || (region != nullptr && !region->contains(cell_x, cell_y)))
+        {
+            ASTAR_STAT(context.stats.rejected_out_of_bounds++;)
+            return false;
+        }
+        if (grid.blocked(cell_x, cell_y))
+        {
+            ASTAR_STAT(context.stats.rejected_obstacle++;)
+            return false;
+        }
+        int bin = context.closed.bin(inter, heading, cell_x, cell_y);
+        if (!context.reexpand_improved && context.is_closed(cell_x, cell_y, bin))
+        {
+            ASTAR_STAT(context.stats.closed_set_hits++;)
+            return false;
+        }
+        if (query.collision != nullptr && !query.collision->motion_free(from.position, from.direction, inter, query.radius, kind))
+        {
+            ASTAR_STAT(context.stats.rejected_collision++;)
+            return false;
+        }
+        successors[successor_count] = path_node(inter, direction, heading, cell_x, cell_y);
+        successors[successor_count].previous = current;
+        bins[successor_count++] = bin;
+        ASTAR_STAT(context.stats.successors_generated++;)
+        return true;
     }
 };
 
-node* create_map(int width, int height, std::vector<obstacle> obs, int start_x, int start_y, int goal_x, int goal_y);
+// Marks every obstacle as blocked in grid.
+inline void rasterize(occupancy_grid& grid, const std::vector<obstacle>& obs)
+{
+    for (const auto& o : obs)
+    {
+        // obstacle::x/width run along rows and obstacle::y/height along columns
+        grid.fill_rect(o.y, o.x, o.height, o.width);
+    }
+}
+
+// Rasterizes the obstacles into map_grid and returns the start cell index.
+std::size_t create_map(int width, int height, const std::vector<obstacle>& obs, int start_x, int start_y, int goal_x, int goal_y);
@@ -0,0 +1,342 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "occupancy_grid.h"
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX // windows.h would otherwise define min and max as macros
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// -- BINARY MAP FORMAT -- //
+
+// A .grid file is this header followed by height rows of stride little-endian 64-bit words,
+// exactly the layout of occupancy_grid, so loading is a single mapping with no parsing.
+struct map_file_header
+{
+    char magic[4] = {'A', 'G', 'R', 'D'};
+    std::uint32_t version = 1;
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    std::uint64_t stride = 0;      // 64-bit words per row
+    std::uint64_t data_offset = 0; // byte offset of the first row, a multiple of 8
+};
+
+// Read-write, copy-on-write view of a whole file: writes through the view stay private to
+// the process and never reach the file.
+class mapped_file
+{
+public:
+    mapped_file() {}
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    ~mapped_file()
+    {
+        close();
+    }
+
+    bool open(const char* path)
+    {
+        close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return false;
+        }
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+        CloseHandle(file); // the mapping keeps the file open
+        if (mapping == nullptr)
+            return false;
+        void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+        CloseHandle(mapping); // and the view keeps the mapping
+        if (view == nullptr)
+            return false;
+        bytes = static_cast<std::uint8_t*>(view);
+        length = std::size_t(file_size.QuadPart);
+#else
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void* view = mmap(nullptr, std::size_t(st.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd); // the mapping keeps the file open
+        if (view == MAP_FAILED)
+            return false;
+        bytes = static_cast<std::uint8_t*>(view);
+        length = std::size_t(st.st_size);
+#endif
+        return true;
+    }
+
+    void close()
+    {
+        if (bytes == nullptr)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(bytes);
+#else
+        munmap(bytes, length);
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+    inline std::uint8_t* data() const
+    {
+        return bytes;
+    }
+    inline std::size_t size() const
+    {
+        return length;
+    }
+
+private:
+    std::uint8_t* bytes = nullptr;
+    std::size_t length = 0;
+};
+
+// Writes grid as a .grid file. Returns false if the file cannot be written.
+inline bool save_map(const occupancy_grid& grid, const char* path)
+{
+    map_file_header header;
+    header.width = std::uint32_t(grid.width);
+    header.height = std::uint32_t(grid.height);
+    header.stride = grid.stride;
+    header.data_offset = sizeof(map_file_header);
+    std::FILE* out = std::fopen(path, "wb");
+    if (out == nullptr)
+        return false;
+    bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1;
+    for (int y = 0; ok && y < grid.height; y++)
+        ok = std::fwrite(grid.row_data(y), sizeof(std::uint64_t), grid.stride, out) == grid.stride;
+    return std::fclose(out) == 0 && ok;
+}
+
+// Maps a .grid file and attaches grid to the mapped rows; no cell is copied or parsed. Pages
+// are faulted in on first touch and the mapping lives as long as grid (or a grid moved from
+// it). Edits to grid are copy-on-write and never change the file. Returns false and leaves
+// grid untouched if the file is missing or malformed.
+inline bool load_map(const char* path, occupancy_grid& grid)
+{
+    auto file = std::make_shared<mapped_file>();
+    if (!file->open(path) || file->size() < sizeof(map_file_header))
+        return false;
+    map_file_header header;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, "AGRD", 4) != 0 || header.version != 1)
+        return false;
+    if (header.width > 0x7fffffffu || header.height > 0x7fffffffu || header.stride != (std::uint64_t(header.width) + 63) / 64)
+        return false;
+    if (header.data_offset % sizeof(std::uint64_t) != 0 || header.data_offset < sizeof(header))
+        return false;
+    // data_offset comes from the file, so it is compared alone before anything is added to it
+    if (header.data_offset > file->size() || header.stride * header.height * sizeof(std::uint64_t) > file->size() - header.data_offset)
+        return false;
+    auto* words = reinterpret_cast<std::uint64_t*>(file->data() + header.data_offset);
+    grid.attach(int(header.width), int(header.height), std::size_t(header.stride), words, file);
+    return true;
+}
+
+// -- PGM / PBM IMPORT -- //
+
+// Streaming reader for binary and ASCII PBM (P4, P1) and PGM (P5, P2) images. Only one image
+// row is buffered at a time, so arbitrarily large rasters can be converted with constant
+// memory. PBM black pixels are blocked; PGM pixels darker than the threshold are blocked.
+class pnm_reader
+{
+public:
+    int width = 0, height = 0;
+    int max_value = 1; // 1 for PBM
+
+    pnm_reader() {}
+    pnm_reader(const pnm_reader&) = delete;
+    pnm_reader& operator=(const pnm_reader&) = delete;
+    ~pnm_reader()
+    {
+        if (in != nullptr)
+            std::fclose(in);
+    }
+
+    // Opens the image and parses its header. threshold is in units of max_value / 255, so
+    // the default 128 splits 8- and 16-bit images at mid-grey.
+    bool open(const char* path, int threshold = 128)
+    {
+        in = std::fopen(path, "rb");
+        if (in == nullptr || std::fgetc(in) != 'P')
+            return false;
+        format = std::fgetc(in) - '0';
+        if (format != 1 && format != 2 && format != 4 && format != 5)
+            return false;
+        if (!read_number(width) || !read_number(height) || width <= 0 || height <= 0)
+            return false;
+        if (format == 2 || format == 5)
+        {
+            if (!read_number(max_value) || max_value <= 0 || max_value > 65535)
+                return false;
+        }
+        cutoff = (long(threshold) * max_value + 127) / 255;
+        if (format == 4 || format == 5)
+        {
+            // read_number consumed the single whitespace byte before the binary pixel data
+            std::size_t sample_bytes = max_value > 255 ? 2 : 1;
+            row_buffer.resize(format == 4 ? (std::size_t(width) + 7) / 8 : std::size_t(width) * sample_bytes);
+        }
+        return true;
+    }
+
+    // Decodes the next image row into stride words of grid bits (1 = blocked); the padding
+    // bits past width are left clear. Returns false on a short or malformed file.
+    bool read_row(std::uint64_t* row, std::size_t stride)
+    {
+        std::memset(row, 0, stride * sizeof(std::uint64_t));
+        if (format == 4 || format == 5)
+        {
+            if (std::fread(row_buffer.data(), 1, row_buffer.size(), in) != row_buffer.size())
+                return false;
+        }
+        for (int x = 0; x < width; x++)
+        {
+            bool blocked = false;
+            if (format == 4)
+                blocked = (row_buffer[x >> 3] >> (7 - (x & 7))) & 1;
+            else if (format == 5)
+            {
+                long value = max_value > 255 ? (long(row_buffer[2 * x]) << 8) | row_buffer[2 * x + 1] : row_buffer[x];
+                blocked = value < cutoff;
+            }
+            else
+            {
+                int value = 0;
+                if (format == 1 ? !read_bit(value) : !read_number(value))
+                    return false;
+                blocked = format == 1 ? value != 0 : value < cutoff;
+            }
+            if (blocked)
+                row[x >> 6] |= std::uint64_t(1) << (x & 63);
+        }
+        return true;
+    }
+
+private:
+    std::FILE* in = nullptr;
+    int format = 0;
+    long cutoff = 0;
+    std::vector<std::uint8_t> row_buffer;
+
+    static bool isspace_char(int c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+    // skips whitespace and # comments, returning the first other character
+    int next_token_char()
+    {
+        int c = std::fgetc(in);
+        while (c != EOF && (isspace_char(c) || c == '#'))
+        {
+            if (c == '#')
+                while (c != EOF && c != '\n')
+                    c = std::fgetc(in);
+            c = std::fgetc(in);
+        }
+        return c;
+    }
+    bool read_number(int& value)
+    {
+        int c = next_token_char();
+        if (c < '0' || c > '9')
+            return false;
+        long v = 0;
+        while (c >= '0' && c <= '9')
+        {
+            v = v * 10 + (c - '0');
+            if (v > 0x7fffffffL)
+                return false;
+            c = std::fgetc(in);
+        }
+        // a whitespace terminator is consumed, anything else is left for the next read
+        if (c != EOF && !isspace_char(c))
+            std::ungetc(c, in);
+        value = int(v);
+        return true;
+    }
+    // P1 pixels are single digits that need not be separated
+    bool read_bit(int& value)
+    {
+        int c = next_token_char();
+        if (c != '0' && c != '1')
+            return false;
+        value = c - '0';
+        return true;
+    }
+};
+
+// Loads a PGM/PBM image into grid, one image row at a time.
+inline bool import_pnm(const char* path, occupancy_grid& grid, int threshold = 128)
+{
+    pnm_reader reader;
+    if (!reader.open(path, threshold))
+        return false;
+    occupancy_grid loaded(reader.width, reader.height);
+    for (int y = 0; y < loaded.height; y++)
+        if (!reader.read_row(loaded.row_data(y), loaded.stride))
+            return false;
+    grid = std::move(loaded);
+    return true;
+}
+
+// Converts a PGM/PBM image straight into a .grid file. Neither the image nor the grid is
+// ever held in memory: each row is decoded and written before the next one is read.
+inline bool convert_pnm(const char* image_path, const char* map_path, int threshold = 128)
+{
+    pnm_reader reader;
+    if (!reader.open(image_path, threshold))
+        return false;
+    map_file_header header;
+    header.width = std::uint32_t(reader.width);
+    header.height = std::uint32_t(reader.height);
+    header.stride = (std::uint64_t(reader.width) + 63) / 64;
+    header.data_offset = sizeof(map_file_header);
+    std::FILE* out = std::fopen(map_path, "wb");
+    if (out == nullptr)
+        return false;
+    std::vector<std::uint64_t> row(header.stride);
+    bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1;
+    for (int y = 0; ok && y < reader.height; y++)
+        ok = reader.read_row(row.data(), row.size()) && std::fwrite(row.data(), sizeof(std::uint64_t), row.size(), out) == row.size();
+    ok = std::fclose(out) == 0 && ok;
+    if (!ok)
+        std::remove(map_path);
+    return ok;
+}
+
+// Loads a map by extension: .pgm/.pbm images are imported, anything else is mapped as .grid.
+inline bool load_map_file(const char* path, occupancy_grid& grid, int threshold = 128)
+{
+    std::size_t n = std::strlen(path);
+    if (n >= 4 && (std::strcmp(path + n - 4, ".pgm") == 0 || std::strcmp(path + n - 4, ".pbm") == 0))
+        return import_pnm(path, grid, threshold);
+    return load_map(path, grid);
+}
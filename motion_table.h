@@ -0,0 +1,243 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <vector>
+#include <math.h>
+#include "geometry.h"
+#include "successor_kernel.h"
+
+// -- MOTION PRIMITIVES -- //
+
+// One successor of a state entering a cell: where it lands relative to the cell's corner,
+// with which heading, and the step cost the search charges for it (the straight-line
+// distance from the entry point, as AStar's exact geometry does). The landing cell is the
+// integer part of the absolute landing point, like every state's.
+struct motion_primitive
+{
+    float x = 0, y = 0;   // landing point relative to the current cell's corner
+    float dx = 0, dy = 0; // direction on arrival, decode_heading(heading)
+    float length = 0;
+    std::uint16_t heading = 0;
+    motion_kind kind = motion_kind::straight;
+};
+
+// Successor geometry for one turning radius, precomputed. Every state but the start lies on
+// the edge of its cell (nudged 0.01 inside), and the turning circles' and straight ray's
+// crossings with the cell only depend on where along which edge it entered, its heading and
+// the radius. The table quantizes that local state to offset_steps positions per edge and
+// heading_steps headings, and stores the successors of each quantized state, computed from
+// its centre with the same kernel and filters as AStar. A lookup replaces the crossing math,
+// normalizations and heading encoding of an expansion; the search is left with the occupancy
+// and closed-set checks. Successors are taken from the quantized state, so a path may jump by
+// up to half a quantization step where one primitive ends and the next begins.
+class motion_table
+{
+public:
+    float radius = 0;
+    int offset_steps = 0;  // entry positions per cell edge
+    int heading_steps = 0; // headings per turn
+    float edge_tolerance = 0.02f; // states farther than this from every edge use exact geometry
+
+    motion_table() {}
+    motion_table(float r, int offsets = 64, int headings = 512)
+    {
+        build(r, offsets, headings);
+    }
+
+    void build(float r, int offsets = 64, int headings = 512)
+    {
+        radius = r;
+        offset_steps = offsets < 1 ? 1 : offsets;
+        heading_steps = headings < 4 ? 4 : (headings > 65536 ? 65536 : headings);
+        std::size_t keys = std::size_t(4) * offset_steps * heading_steps;
+        first.assign(keys + 1, 0);
+        primitives.clear();
+        for (std::size_t key = 0; key < keys; key++)
+        {
+            first[key] = std::uint32_t(primitives.size());
+            add_primitives(int(key / (std::size_t(offset_steps) * heading_steps)), int(key / heading_steps % offset_steps), int(key % heading_steps));
+        }
+        first[keys] = std::uint32_t(primitives.size());
+        primitives.shrink_to_fit();
+    }
+
+    // Successors of the state at position (inside cell (x, y)) with the given fixed-point
+    // heading. Returns false when the state is not on a cell edge (a query's start state) or
+    // the table is empty; the caller then uses the exact geometry.
+    inline bool lookup(const vector2d& position, std::uint16_t heading, int x, int y, std::span<const motion_primitive>& out) const
+    {
+        if (first.empty())
+            return false;
+        float fx = position.x - x;
+        float fy = position.y - y;
+        // nearest cell edge: 0 left, 1 right, 2 top, 3 bottom, as in state_lattice::bin
+        int edge = 0;
+        float best = fx;
+        float offset = fy;
+        if (1 - fx < best) { best = 1 - fx; edge = 1; }
+        if (fy < best) { best = fy; edge = 2; offset = fx; }
+        if (1 - fy < best) { best = 1 - fy; edge = 3; offset = fx; }
+        if (best > edge_tolerance)
+            return false;
+        int offset_index = int(offset * offset_steps);
+        offset_index = offset_index < 0 ? 0 : (offset_index >= offset_steps ? offset_steps - 1 : offset_index);
+        int heading_index = int(((std::uint32_t(heading) * std::uint32_t(heading_steps) + 32768) >> 16) % std::uint32_t(heading_steps));
+        std::size_t key = (std::size_t(edge) * offset_steps + offset_index) * heading_steps + heading_index;
+        out = std::span<const motion_primitive>(primitives.data() + first[key], first[key + 1] - first[key]);
+        return true;
+    }
+
+    inline std::size_t primitive_count() const
+    {
+        return primitives.size();
+    }
+    inline std::size_t memory_bytes() const
+    {
+        return first.capacity() * sizeof(std::uint32_t) + primitives.capacity() * sizeof(motion_primitive);
+    }
+
+    // -- DISK CACHE -- //
+
+    // Writes the table to path. Returns false if the file cannot be written.
+    bool save(const char* path) const
+    {
+        file_header header;
+        header.radius = radius;
+        header.offset_steps = std::uint32_t(offset_steps);
+        header.heading_steps = std::uint32_t(heading_steps);
+        header.primitive_count = std::uint32_t(primitives.size());
+        std::FILE* out = std::fopen(path, "wb");
+        if (out == nullptr)
+            return false;
+        bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1;
+        ok = ok && std::fwrite(first.data(), sizeof(std::uint32_t), first.size(), out) == first.size();
+        ok = ok && std::fwrite(primitives.data(), sizeof(motion_primitive), primitives.size(), out) == primitives.size();
+        return std::fclose(out) == 0 && ok;
+    }
+
+    // Reads a table written by save(). Returns false and leaves the table untouched if the
+    // file is missing or malformed.
+    bool load(const char* path)
+    {
+        std::FILE* in = std::fopen(path, "rb");
+        if (in == nullptr)
+            return false;
+        file_header header;
+        bool ok = std::fread(&header, sizeof(header), 1, in) == 1 && std::memcmp(header.magic, "AMPT", 4) == 0 && header.version == 2 &&
+                  header.offset_steps >= 1 && header.offset_steps <= 4096 && header.heading_steps >= 4 && header.heading_steps <= 65536;
+        std::vector<std::uint32_t> read_first;
+        std::vector<motion_primitive> read_primitives;
+        std::size_t keys = std::size_t(4) * header.offset_steps * header.heading_steps;
+        ok = ok && header.primitive_count <= 20 * keys; // an expansion has at most 20 successors
+        if (ok)
+        {
+            // the header's sizes must fit in the file before anything is allocated for them
+            std::fseek(in, 0, SEEK_END);
+            long size = std::ftell(in);
+            std::uint64_t needed = sizeof(header) + (keys + 1) * sizeof(std::uint32_t) + std::uint64_t(header.primitive_count) * sizeof(motion_primitive);
+            ok = size >= 0 && std::uint64_t(size) >= needed;
+            std::fseek(in, long(sizeof(header)), SEEK_SET);
+        }
+        if (ok)
+        {
+            read_first.resize(keys + 1);
+            read_primitives.resize(header.primitive_count);
+            ok = std::fread(read_first.data(), sizeof(std::uint32_t), read_first.size(), in) == read_first.size() &&
+                 std::fread(read_primitives.data(), sizeof(motion_primitive), read_primitives.size(), in) == read_primitives.size();
+        }
+        std::fclose(in);
+        // every key's range must lie inside the primitives, in order
+        for (std::size_t i = 0; ok && i + 1 < read_first.size(); i++)
+            ok = read_first[i] <= read_first[i + 1];
+        ok = ok && read_first.front() == 0 && read_first.back() == header.primitive_count;
+        // a kind past the enumerators would be swept as a right turn
+        for (std::size_t i = 0; ok && i < read_primitives.size(); i++)
+            ok = std::uint8_t(read_primitives[i].kind) <= std::uint8_t(motion_kind::right);
+        if (!ok)
+            return false;
+        radius = header.radius;
+        offset_steps = int(header.offset_steps);
+        heading_steps = int(header.heading_steps);
+        first.swap(read_first);
+        primitives.swap(read_primitives);
+        return true;
+    }
+
+    // Loads the table for radius r from path, or builds it and writes it there when the file
+    // is missing, malformed or holds a table with other parameters. Returns true when the
+    // table came from the file; either way the table is ready afterwards.
+    bool load_or_build(const char* path, float r, int offsets = 64, int headings = 512)
+    {
+        motion_table cached;
+        if (cached.load(path) && cached.radius == r && cached.offset_steps == offsets && cached.heading_steps == headings)
+        {
+            *this = std::move(cached);
+            return true;
+        }
+        build(r, offsets, headings);
+        save(path);
+        return false;
+    }
+
+private:
+    struct file_header
+    {
+        char magic[4] = {'A', 'M', 'P', 'T'};
+        std::uint32_t version = 2; // 2: primitives record their motion_kind
+        float radius = 0;
+        std::uint32_t offset_steps = 0;
+        std::uint32_t heading_steps = 0;
+        std::uint32_t primitive_count = 0;
+    };
+
+    std::vector<std::uint32_t> first; // per key, index of its first primitive; one extra entry at the end
+    std::vector<motion_primitive> primitives;
+
+    // Appends the successors of the state at the centre of key (edge, offset_index,
+    // heading_index), placed in the cell (0, 0) like a state nudged in from that edge.
+    void add_primitives(int edge, int offset_index, int heading_index)
+    {
+        std::uint16_t heading = std::uint16_t((std::uint64_t(heading_index) * 65536) / std::uint64_t(heading_steps));
+        vector2d direction = decode_heading(heading);
+        float offset = (offset_index + 0.5f) / offset_steps;
+        vector2d entry = edge == 0 ? vector2d(0, offset) : edge == 1 ? vector2d(1, offset) : edge == 2 ? vector2d(offset, 0) : vector2d(offset, 1);
+        vector2d position = entry + direction * 0.01f;
+
+        cell_crossings crossings;
+        vector2d circle_pos[2];
+        circle_pos[0] = position + (direction.perpendicular(0).normalize() * radius);
+        circle_pos[1] = position + (direction.perpendicular(1).normalize() * radius);
+        cell_successor_crossings(0, 0, position, direction, circle_pos, radius, 1.0f, crossings);
+        for (int side = 0; side < 2; side++)
+        {
+            for (int i = 0; i < crossings.circle_count[side]; i++)
+            {
+                vector2d inter = crossings.circle[side][i];
+                vector2d new_dir = (inter - circle_pos[side]).normalize().perpendicular(side).normalize();
+                if (direction.dot(new_dir) <= 0)
+                    new_dir = new_dir * -1.0f;
+                std::uint16_t new_heading = encode_heading(new_dir);
+                add(position, direction, inter + new_dir * 0.01f, decode_heading(new_heading), new_heading, side == 1 ? motion_kind::left : motion_kind::right);
+            }
+        }
+        for (int i = 0; i < crossings.line_count; i++)
+            add(position, direction, crossings.line[i] + direction * 0.01f, direction, heading, motion_kind::straight);
+    }
+    inline void add(const vector2d& from, const vector2d& direction, const vector2d& inter, const vector2d& new_dir, std::uint16_t new_heading, motion_kind kind)
+    {
+        if ((inter - from).normalize().dot(direction) <= 0)
+            return; // behind the agent, as AStar drops it
+        motion_primitive p;
+        p.x = inter.x;
+        p.y = inter.y;
+        p.dx = new_dir.x;
+        p.dy = new_dir.y;
+        p.length = (from - inter).magnitude();
+        p.heading = new_heading;
+        p.kind = kind;
+        primitives.push_back(p);
+    }
+};
@@ -0,0 +1,189 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+// Flat row-major occupancy grid, one bit per cell (1 = blocked).
+// Rows are padded to whole 64-bit words so rectangles can be rasterized a word at a time.
+// The words normally live in the grid's own vector; attach() points the grid at words owned
+// elsewhere instead (e.g. a memory-mapped map file, see map_io.h) without copying them.
+class occupancy_grid
+{
+public:
+    int width = 0, height = 0;
+    std::size_t stride = 0; // 64-bit words per row
+    std::uint64_t version = 0; // bumped by every edit, so cached results can tell the map changed
+    std::uint64_t id = next_id(); // unique per grid, copies included, so caches can tell maps apart
+
+    occupancy_grid() {}
+    occupancy_grid(int w, int h) { resize(w, h); }
+
+    // Copies always own their words, so writing to a copy never touches the source's storage.
+    occupancy_grid(const occupancy_grid& other)
+        : width(other.width), height(other.height), stride(other.stride), version(other.version), bits(other.words, other.words + other.word_count())
+    {
+        words = bits.data();
+    }
+    occupancy_grid(occupancy_grid&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+    occupancy_grid& operator=(const occupancy_grid& other)
+    {
+        if (this != &other)
+            *this = occupancy_grid(other);
+        return *this;
+    }
+    occupancy_grid& operator=(occupancy_grid&& other) noexcept
+    {
+        width = other.width;
+        height = other.height;
+        stride = other.stride;
+        version = other.version;
+        id = other.id;
+        other.id = next_id(); // the emptied grid may be refilled, and must not pass for this one
+        bool owned = other.words == other.bits.data();
+        bits = std::move(other.bits);
+        words = owned ? bits.data() : other.words;
+        owner = std::move(other.owner);
+        other.width = other.height = 0;
+        other.stride = 0;
+        other.bits.clear();
+        other.words = nullptr;
+        return *this;
+    }
+
+    void resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        stride = (std::size_t(w) + 63) / 64;
+        bits.assign(stride * std::size_t(h), 0);
+        words = bits.data();
+        owner.reset();
+        version++;
+    }
+
+    // Uses external storage of stride_words * h words laid out like the grid's own rows.
+    // storage_owner is kept alive for as long as the grid uses the words; writes go straight
+    // to the external words.
+    void attach(int w, int h, std::size_t stride_words, std::uint64_t* external, std::shared_ptr<void> storage_owner)
+    {
+        width = w;
+        height = h;
+        stride = stride_words;
+        bits.clear();
+        bits.shrink_to_fit();
+        words = external;
+        owner = std::move(storage_owner);
+        version++;
+    }
+    // True when the words belong to someone else (see attach).
+    inline bool attached() const
+    {
+        return owner != nullptr;
+    }
+
+    // cell index API
+
+    inline bool in_bounds(int x, int y) const
+    {
+        return x >= 0 && x < width && y >= 0 && y < height;
+    }
+    inline std::size_t index(int x, int y) const
+    {
+        return std::size_t(y) * std::size_t(width) + std::size_t(x);
+    }
+    inline int cell_x(std::size_t cell) const
+    {
+        return int(cell % std::size_t(width));
+    }
+    inline int cell_y(std::size_t cell) const
+    {
+        return int(cell / std::size_t(width));
+    }
+    inline std::size_t cell_count() const
+    {
+        return std::size_t(width) * std::size_t(height);
+    }
+
+    // occupancy
+
+    inline bool blocked(int x, int y) const
+    {
+        return (words[std::size_t(y) * stride + (x >> 6)] >> (x & 63)) & 1;
+    }
+    inline bool is_free(int x, int y) const
+    {
+        return in_bounds(x, y) && !blocked(x, y);
+    }
+    inline void set_blocked(int x, int y, bool value)
+    {
+        std::uint64_t& word = words[std::size_t(y) * stride + (x >> 6)];
+        std::uint64_t mask = std::uint64_t(1) << (x & 63);
+        word = value ? (word | mask) : (word & ~mask);
+        version++;
+    }
+
+    // Marks the rectangle [x, x + w) x [y, y + h) as blocked, clipped to the grid.
+    void fill_rect(int x, int y, int w, int h)
+    {
+        int x0 = x < 0 ? 0 : x;
+        int y0 = y < 0 ? 0 : y;
+        int x1 = x + w > width ? width : x + w;
+        int y1 = y + h > height ? height : y + h;
+        if (x0 >= x1 || y0 >= y1)
+            return;
+        version++;
+        std::size_t first_word = std::size_t(x0) >> 6;
+        std::size_t last_word = std::size_t(x1 - 1) >> 6;
+        std::uint64_t first_mask = ~std::uint64_t(0) << (x0 & 63);
+        std::uint64_t last_mask = ~std::uint64_t(0) >> (63 - ((x1 - 1) & 63));
+        for (int row = y0; row < y1; ++row)
+        {
+            std::uint64_t* row_words = row_data(row);
+            if (first_word == last_word)
+            {
+                row_words[first_word] |= first_mask & last_mask;
+                continue;
+            }
+            row_words[first_word] |= first_mask;
+            for (std::size_t i = first_word + 1; i < last_word; ++i)
+                row_words[i] = ~std::uint64_t(0);
+            row_words[last_word] |= last_mask;
+        }
+    }
+
+    // raw rows, stride words each; bit x of a row is bit (x & 63) of word (x >> 6)
+
+    inline std::uint64_t* row_data(int y)
+    {
+        return words + std::size_t(y) * stride;
+    }
+    inline const std::uint64_t* row_data(int y) const
+    {
+        return words + std::size_t(y) * stride;
+    }
+    inline std::size_t word_count() const
+    {
+        return stride * std::size_t(height);
+    }
+
+    inline std::size_t memory_bytes() const
+    {
+        return word_count() * sizeof(std::uint64_t);
+    }
+
+private:
+    std::vector<std::uint64_t> bits;
+    std::uint64_t* words = nullptr;
+    std::shared_ptr<void> owner; // keeps attached storage alive
+
+    static std::uint64_t next_id()
+    {
+        static std::atomic<std::uint64_t> counter{0};
+        return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+};
@@ -0,0 +1,361 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Open-list implementations for the A* frontier, chosen at compile time:
+//   default                     indexed d-ary heap, ASTAR_HEAP_ARITY children per entry (4)
+//   -DASTAR_BUCKET_QUEUE=1      bucket queue over costs quantized to 1 / ASTAR_BUCKETS_PER_UNIT
+// Both hold state ids (indices into a SearchContext's state pool) with their costs, and both
+// are indexed: they record the slot of every id they hold, so an open state whose cost drops
+// can be moved in place (decrease) instead of being pushed a second time.
+#ifndef ASTAR_BUCKET_QUEUE
+#define ASTAR_BUCKET_QUEUE 0
+#endif
+#ifndef ASTAR_HEAP_ARITY
+#define ASTAR_HEAP_ARITY 4
+#endif
+#ifndef ASTAR_BUCKETS_PER_UNIT
+#define ASTAR_BUCKETS_PER_UNIT 64
+#endif
+
+using state_id = std::uint32_t;
+constexpr state_id no_state = 0xffffffffu;
+
+// -- INDEXED D-ARY HEAP -- //
+
+// Min-heap on cost. Entries are 8 bytes, a copy of the cost next to the id, so sifting
+// compares without touching the state pool; only the moved id's slot is written.
+template <int D>
+class dary_heap
+{
+public:
+    inline std::size_t size() const
+    {
+        return entries.size();
+    }
+    inline state_id front() const
+    {
+        return entries[0].id;
+    }
+    inline void clear()
+    {
+        entries.clear();
+    }
+    inline std::size_t memory_bytes() const
+    {
+        return entries.capacity() * sizeof(entry) + slots.capacity() * sizeof(std::uint32_t);
+    }
+    // Calls f(id) for every state in the heap, in no particular order.
+    template <class F>
+    inline void for_each(const F& f) const
+    {
+        for (const entry& e : entries)
+            f(e.id);
+    }
+
+    inline void push(state_id id, float cost)
+    {
+        if (id >= slots.size())
+            slots.resize(std::size_t(id) + id / 2 + 1024);
+        entries.push_back(entry{cost, id});
+        sift_up(entries.size() - 1);
+    }
+    inline state_id pop()
+    {
+        state_id top = entries[0].id;
+        entry last = entries.back();
+        entries.pop_back();
+        if (!entries.empty())
+        {
+            entries[0] = last;
+            sift_down(0);
+        }
+        return top;
+    }
+    // id is in the heap and its cost was lowered from old_cost to cost.
+    inline void decrease(state_id id, float cost, float /*old_cost*/)
+    {
+        std::uint32_t i = slots[id];
+        entries[i].cost = cost;
+        sift_up(i);
+    }
+
+private:
+    struct entry
+    {
+        float cost;
+        state_id id;
+    };
+    std::vector<entry> entries;
+    std::vector<std::uint32_t> slots; // entry index of every id while it is in the heap
+
+    inline void place(std::size_t i, const entry& e)
+    {
+        entries[i] = e;
+        slots[e.id] = std::uint32_t(i);
+    }
+    inline void sift_up(std::size_t i)
+    {
+        entry moving = entries[i];
+        while (i > 0)
+        {
+            std::size_t parent = (i - 1) / D;
+            if (!(moving.cost < entries[parent].cost))
+                break;
+            place(i, entries[parent]);
+            i = parent;
+        }
+        place(i, moving);
+    }
+    inline void sift_down(std::size_t i)
+    {
+        entry moving = entries[i];
+        const std::size_t n = entries.size();
+        while (true)
+        {
+            std::size_t first = i * D + 1;
+            if (first >= n)
+                break;
+            std::size_t last = first + D < n ? first + D : n;
+            std::size_t best = first;
+            for (std::size_t c = first + 1; c < last; c++)
+                if (entries[c].cost < entries[best].cost)
+                    best = c;
+            if (!(entries[best].cost < moving.cost))
+                break;
+            place(i, entries[best]);
+            i = best;
+        }
+        place(i, moving);
+    }
+};
+
+// -- BUCKET QUEUE -- //
+
+// Costs are quantized to 1 / buckets_per_unit and every bucket is an unordered vector, so push,
+// pop and decrease are O(1) apart from the scan to the next non-empty bucket. Within a bucket
+// the order is last in, first out: pops are only ordered to within one bucket width. A*'s
+// costs rarely go down along a search, so the scan cursor mostly moves forward.
+template <int buckets_per_unit>
+class bucket_queue
+{
+public:
+    inline std::size_t size() const
+    {
+        return count;
+    }
+    inline state_id front()
+    {
+        advance();
+        return buckets[cursor].back();
+    }
+    inline void clear()
+    {
+        for (std::size_t b = cursor; b < high; b++)
+            buckets[b].clear();
+        count = 0;
+        cursor = 0;
+        high = 0;
+    }
+    inline std::size_t memory_bytes() const
+    {
+        std::size_t bytes = buckets.capacity() * sizeof(std::vector<state_id>) + slots.capacity() * sizeof(std::uint32_t);
+        for (const auto& bucket : buckets)
+            bytes += bucket.capacity() * sizeof(state_id);
+        return bytes;
+    }
+    // Calls f(id) for every state in the queue, in no particular order.
+    template <class F>
+    inline void for_each(const F& f) const
+    {
+        for (std::size_t b = cursor; b < high; b++)
+            for (state_id id : buckets[b])
+                f(id);
+    }
+
+    inline void push(state_id id, float cost)
+    {
+        std::size_t b = key(cost);
+        if (b >= buckets.size())
+            buckets.resize(b + b / 2 + 64);
+        if (id >= slots.size())
+            slots.resize(std::size_t(id) + id / 2 + 1024);
+        slots[id] = std::uint32_t(buckets[b].size());
+        buckets[b].push_back(id);
+        if (count == 0 || b < cursor)
+            cursor = b;
+        if (b >= high)
+            high = b + 1;
+        count++;
+    }
+    inline state_id pop()
+    {
+        advance();
+        state_id id = buckets[cursor].back();
+        buckets[cursor].pop_back();
+        count--;
+        return id;
+    }
+    // id is in the queue and its cost was lowered from old_cost, which locates its bucket.
+    inline void decrease(state_id id, float cost, float old_cost)
+    {
+        std::size_t from = key(old_cost);
+        if (from == key(cost))
+            return;
+        auto& bucket = buckets[from];
+        state_id last = bucket.back();
+        bucket[slots[id]] = last;
+        slots[last] = slots[id];
+        bucket.pop_back();
+        count--;
+        push(id, cost);
+    }
+
+private:
+    std::vector<std::vector<state_id>> buckets; // bucket b holds costs in [b, b + 1) / buckets_per_unit
+    std::vector<std::uint32_t> slots;           // position of every id in its bucket
+    std::size_t count = 0;
+    std::size_t cursor = 0; // no non-empty bucket below this one
+    std::size_t high = 0;   // no non-empty bucket at or above this one
+
+    inline static std::size_t key(float cost)
+    {
+        return cost > 0 ? std::size_t(cost * buckets_per_unit) : 0;
+    }
+    inline void advance()
+    {
+        while (buckets[cursor].empty())
+            cursor++;
+    }
+};
+
+// -- STATE TABLE -- //
+
+// Maps a closed-set key (cell and lattice bin) to a state id, e.g. the open state holding
+// that bin, so a new arrival in the bin can be merged with it instead of being pushed as a
+// duplicate. Linear probing over a power-of-two table of 16-byte slots; a generation stamp
+// per slot makes clear() O(1), and erase() shifts the probe run back instead of leaving
+// tombstones, so a table whose entries are erased as bins close stays as small as the frontier.
+class open_table
+{
+public:
+    inline void clear()
+    {
+        count = 0;
+        if (++generation == 0)
+        {
+            for (auto& s : slots)
+                s.generation = 0;
+            generation = 1;
+        }
+    }
+    inline std::size_t size() const
+    {
+        return count;
+    }
+    inline std::size_t memory_bytes() const
+    {
+        return slots.capacity() * sizeof(slot);
+    }
+
+    // The id stored for key k, or no_state.
+    inline state_id find(std::uint64_t k) const
+    {
+        if (count == 0)
+            return no_state;
+        std::size_t mask = slots.size() - 1;
+        for (std::size_t i = hash(k) & mask;; i = (i + 1) & mask)
+        {
+            const slot& s = slots[i];
+            if (s.generation != generation)
+                return no_state;
+            if (s.key == k)
+                return s.id;
+        }
+    }
+    // Sets the id for key k, replacing any earlier one.
+    inline void insert(std::uint64_t k, state_id id)
+    {
+        if (2 * (count + 1) > slots.size())
+            grow();
+        std::size_t mask = slots.size() - 1;
+        for (std::size_t i = hash(k) & mask;; i = (i + 1) & mask)
+        {
+            slot& s = slots[i];
+            if (s.generation != generation)
+            {
+                s = slot{k, id, generation};
+                count++;
+                return;
+            }
+            if (s.key == k)
+            {
+                s.id = id;
+                return;
+            }
+        }
+    }
+    // Removes key k if it is present.
+    inline void erase(std::uint64_t k)
+    {
+        if (count == 0)
+            return;
+        std::size_t mask = slots.size() - 1;
+        std::size_t hole = hash(k) & mask;
+        while (true)
+        {
+            if (slots[hole].generation != generation)
+                return;
+            if (slots[hole].key == k)
+                break;
+            hole = (hole + 1) & mask;
+        }
+        count--;
+        // move later entries of the probe run into the hole when their home allows it
+        for (std::size_t i = (hole + 1) & mask; slots[i].generation == generation; i = (i + 1) & mask)
+        {
+            std::size_t home = hash(slots[i].key) & mask;
+            if (((i - home) & mask) >= ((i - hole) & mask))
+            {
+                slots[hole] = slots[i];
+                hole = i;
+            }
+        }
+        slots[hole].generation = generation - 1;
+    }
+
+private:
+    struct slot
+    {
+        std::uint64_t key;
+        state_id id;
+        std::uint32_t generation;
+    };
+    std::vector<slot> slots;
+    std::size_t count = 0;
+    std::uint32_t generation = 1;
+
+    inline static std::size_t hash(std::uint64_t k)
+    {
+        return std::size_t((k * 0x9E3779B97F4A7C15ull) >> 20);
+    }
+    void grow()
+    {
+        std::vector<slot> old;
+        old.swap(slots);
+        slots.assign(old.empty() ? 1024 : old.size() * 2, slot{0, no_state, 0});
+        std::uint32_t live = generation;
+        generation = 1;
+        count = 0;
+        for (const auto& s : old)
+            if (s.generation == live)
+                insert(s.key, s.id);
+    }
+};
+
+#if ASTAR_BUCKET_QUEUE
+using open_list = bucket_queue<ASTAR_BUCKETS_PER_UNIT>;
+#else
+using open_list = dary_heap<ASTAR_HEAP_ARITY>;
+#endif
@@ -0,0 +1,446 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "main.h"
+
+// -- MPSC QUEUE -- //
+
+// Lock-free multi-producer, single-consumer queue of message batches. Producers link a whole
+// batch onto the head with one compare-and-swap; the consumer takes every queued batch with
+// one exchange. Batches come out newest first.
+template <class T>
+class mpsc_queue
+{
+public:
+    struct batch
+    {
+        batch* next = nullptr;
+        std::vector<T> items;
+    };
+
+    mpsc_queue() {}
+    mpsc_queue(const mpsc_queue&) = delete;
+    mpsc_queue& operator=(const mpsc_queue&) = delete;
+    ~mpsc_queue()
+    {
+        for (batch* b = take_all(); b != nullptr;)
+        {
+            batch* next = b->next;
+            delete b;
+            b = next;
+        }
+    }
+
+    inline void push(batch* b)
+    {
+        b->next = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(b->next, b, std::memory_order_release, std::memory_order_relaxed))
+        {
+        }
+    }
+    // Every batch pushed so far, linked through next, or null.
+    inline batch* take_all()
+    {
+        if (head.load(std::memory_order_relaxed) == nullptr)
+            return nullptr;
+        return head.exchange(nullptr, std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<batch*> head{nullptr};
+};
+
+// -- HASH-DISTRIBUTED PARALLEL SEARCH -- //
+
+// HDA*: one query searched by several threads. Every state has an owner thread chosen by a
+// hash of its cell and lattice bin (which includes the heading bin); only the owner keeps it
+// in its open list and closed set, so threads never share search structures. A thread expands
+// its cheapest open state and sends each successor to the successor's owner through that
+// owner's lock-free queue, in batches.
+//
+// Without one global order, a bin can be reached more cheaply after it was expanded; the owner
+// then reopens it when the saving exceeds reopen_margin. (Inside one cell a later arrival is
+// often a hair cheaper even in a sequential search, which ignores it; reopening for those
+// costs far more expansions than it saves path length.) Each thread publishes the cost of its
+// cheapest open state, lowered by senders to the cheapest message they push to it, and a
+// thread whose cheapest state costs more than max_lead above the lowest published cost yields
+// instead of expanding. Left alone, a thread that runs ahead (always so when threads share a
+// core) expands bins a sequential search never would, and their owners reopen them when the
+// cheaper arrival comes; on the lattice every such bin seeds successors in other heading bins,
+// so the extra work grows with the thread count. With max_lead at most reopen_margin, a bin
+// is reopened only for the slack inside it that a one-thread search reopens too. A state in the goal
+// cell becomes the incumbent path when it is cheaper than the current one, and states whose
+// cost is not below the incumbent's are dropped. The search ends when every thread is out of
+// such work and no message is in flight, counted by one atomic work counter: the number of
+// threads with work plus the number of messages sent and not yet taken in. A sender adds its
+// batch before pushing it and a receiver becomes busy before subtracting what it took, so the
+// counter cannot pass through zero while work remains.
+class ParallelAStar
+{
+public:
+    std::size_t batch_size = 64; // successors sent to one thread at a time
+    int expansions_per_poll = 16; // expansions between checks of the inbox
+    float reopen_margin = 0.1f;   // an expanded bin is reopened when reached this much more cheaply
+    float max_lead = 0.1f;        // how far above the cheapest open state of any thread a thread may expand
+
+    ParallelAStar(unsigned threads = std::thread::hardware_concurrency(), int heading_bins = 32, int offset_bins = 1)
+    {
+        if (threads == 0)
+            threads = 1;
+        for (unsigned i = 0; i < threads; i++)
+            workers.emplace_back(new worker(heading_bins, offset_bins, threads));
+    }
+    ~ParallelAStar()
+    {
+        for (auto& w : workers)
+        {
+            for (message_batch* b : w->outgoing)
+                delete b;
+            for (message_batch* b : w->spare)
+                delete b;
+        }
+    }
+
+    ParallelAStar(const ParallelAStar&) = delete;
+    ParallelAStar& operator=(const ParallelAStar&) = delete;
+
+    inline unsigned thread_count() const
+    {
+        return unsigned(workers.size());
+    }
+
+    // Same contract as AStar::get_path, with the result's cost, pose, expansions (summed over
+    // threads) and stats written to result. Runs the search on thread_count() threads, the
+    // caller's included.
+    template <class Grid>
+    bool get_path(const Grid& grid, SearchContext& result, const Query& query, std::vector<std::size_t>& path, const heuristic& h = heuristic())
+    {
+        result.reset(grid.width, grid.height);
+        path.clear();
+        for (auto& w : workers)
+        {
+            w->context.reset(grid.width, grid.height);
+            w->context.reexpand_improved = true; // closed bins are judged by their owner in receive()
+            w->lowest.store(INFINITY, std::memory_order_relaxed);
+        }
+        incumbent.store(INFINITY, std::memory_order_relaxed);
+        goal = no_state;
+        stop.store(false, std::memory_order_relaxed);
+        if (!AStar::valid_query(grid, query))
+            return false;
+
+        // the start state is the first message in flight
+        work.store(1, std::memory_order_relaxed);
+        message start;
+        start.position = query.start;
+        start.heading = encode_heading(query.direction);
+        start.cost = h.estimate(query.start, query.direction, query.goal_x, query.goal_y);
+        start.bin = workers[0]->context.closed.bin(start.position, start.heading, int(start.position.x), int(start.position.y));
+        worker& owner = *workers[owner_of(grid.index(int(start.position.x), int(start.position.y)), start.bin)];
+        message_batch* first = take_batch(owner);
+        first->items.push_back(start);
+        owner.inbox.push(first);
+
+        std::vector<std::thread> threads;
+        for (unsigned i = 1; i < workers.size(); i++)
+            threads.emplace_back([&, i] { run(grid, query, h, i); });
+        run(grid, query, h, 0);
+        for (auto& t : threads)
+            t.join();
+
+        for (auto& w : workers)
+        {
+            result.expansions += w->context.expansions;
+            if (w->context.peak_frontier > result.peak_frontier)
+                result.peak_frontier = w->context.peak_frontier;
+            ASTAR_STAT(result.stats.add(w->context.stats);)
+        }
+        ASTAR_STAT(result.stats.nodes_expanded = result.expansions; result.stats.peak_frontier = result.peak_frontier;)
+        if (goal == no_state)
+            return false;
+        // the chain of previous states crosses the workers' pools
+        const SearchContext* pool = &workers[goal_pool]->context;
+        result.path_cost = pool->g(goal);
+        result.path_position = pool->position(goal);
+        result.path_direction = pool->direction(goal);
+        for (state_id step = goal; step != no_state;)
+        {
+            path.push_back(grid.index(pool->cell_x(step), pool->cell_y(step)));
+            state_id previous = pool->previous(step);
+            pool = &workers[pool->previous_pool(step)]->context;
+            step = previous;
+        }
+        return true;
+    }
+
+private:
+    struct message
+    {
+        vector2d position;
+        state_id previous = no_state; // in the pool of worker previous_pool, which outlives the search
+        std::uint16_t heading = 0;
+        std::uint16_t previous_pool = 0;
+        float g = 0;
+        float cost = 0;
+        int bin = 0;
+    };
+    using message_batch = mpsc_queue<message>::batch;
+
+    struct worker
+    {
+        SearchContext context;
+        mpsc_queue<message> inbox;
+        std::vector<message_batch*> outgoing; // per destination thread, null when empty
+        std::vector<message_batch*> spare;    // emptied batches, reused for sending
+        alignas(64) std::atomic<float> lowest{INFINITY}; // cost of the cheapest open state, INFINITY when idle
+
+        worker(int heading_bins, int offset_bins, unsigned threads)
+            : context(heading_bins, offset_bins), outgoing(threads, nullptr)
+        {
+        }
+    };
+
+    std::vector<std::unique_ptr<worker>> workers;
+    alignas(64) std::atomic<std::int64_t> work{0};
+    alignas(64) std::atomic<float> incumbent{INFINITY};
+    std::atomic<bool> stop{false};
+    std::mutex goal_mutex;
+    state_id goal = no_state;
+    unsigned goal_pool = 0; // worker whose pool holds goal
+
+    inline std::size_t owner_of(std::size_t cell, int bin) const
+    {
+        std::uint64_t k = std::uint64_t(cell) * 0x9E3779B97F4A7C15ull ^ std::uint64_t(bin) * 0xC2B2AE3D27D4EB4Full;
+        return std::size_t((k >> 32) % workers.size());
+    }
+    // Cheapest open state any thread has published.
+    inline float lowest_open() const
+    {
+        float lowest = INFINITY;
+        for (const auto& w : workers)
+            lowest = std::min(lowest, w->lowest.load(std::memory_order_relaxed));
+        return lowest;
+    }
+    inline message_batch* take_batch(worker& w)
+    {
+        if (w.spare.empty())
+            return new message_batch();
+        message_batch* b = w.spare.back();
+        w.spare.pop_back();
+        return b;
+    }
+    // Pushes b into the inbox of thread to. Its cheapest message lowers the thread's published
+    // cost until the thread takes it in and publishes its own again.
+    inline void send(std::size_t to, message_batch* b)
+    {
+        float cheapest = INFINITY;
+        for (const message& m : b->items)
+            cheapest = std::min(cheapest, m.cost);
+        std::atomic<float>& lowest = workers[to]->lowest;
+        float seen = lowest.load(std::memory_order_relaxed);
+        while (cheapest < seen && !lowest.compare_exchange_weak(seen, cheapest, std::memory_order_relaxed))
+        {
+        }
+        work.fetch_add(std::int64_t(b->items.size()), std::memory_order_relaxed);
+        workers[to]->inbox.push(b);
+    }
+    // Sends every non-empty outgoing batch of w.
+    inline void flush(worker& w)
+    {
+        for (std::size_t to = 0; to < w.outgoing.size(); to++)
+        {
+            message_batch* b = w.outgoing[to];
+            if (b == nullptr)
+                continue;
+            w.outgoing[to] = nullptr;
+            send(to, b);
+        }
+    }
+
+    // Adds a state owned by w, unless its bin already holds one at least as cheap.
+    template <class Grid>
+    inline void receive(const Grid& grid, worker& w, const message& m)
+    {
+        SearchContext& context = w.context;
+        if (m.cost >= incumbent.load(std::memory_order_relaxed))
+            return;
+        int x = int(m.position.x), y = int(m.position.y);
+        std::size_t cell = grid.index(x, y);
+        path_node n(m.position, m.heading, x, y);
+        n.previous = m.previous;
+        n.g = m.g;
+        n.cost = m.cost;
+        if (context.is_closed(x, y, m.bin))
+        {
+            // the bin's expanded state, or a cheaper arrival recorded after it
+            state_id best = context.find_best(cell, m.bin);
+            if (best != no_state && context.g(best) <= m.g + reopen_margin)
+            {
+                ASTAR_STAT(context.stats.closed_set_hits++;)
+                return;
+            }
+            context.closed.clear(x, y, m.bin); // reached more cheaply after its expansion
+            ASTAR_STAT(context.stats.reopened++;)
+        }
+        else
+        {
+            state_id open = context.find_open(cell, m.bin);
+            if (open != no_state)
+            {
+                float old_cost = context.cost(open);
+                if (old_cost <= m.cost)
+                {
+                    ASTAR_STAT(context.stats.merged_successors++;)
+                    return;
+                }
+                context.set_state(open, n);
+                context.set_previous(open, m.previous, m.previous_pool);
+                context.decrease(open, old_cost);
+                context.set_best(cell, m.bin, open);
+                return;
+            }
+        }
+        state_id i = context.add_state(n);
+        context.set_previous(i, m.previous, m.previous_pool);
+        context.push(i);
+        context.set_open(cell, m.bin, i);
+        context.set_best(cell, m.bin, i);
+    }
+
+    // Pops w's cheapest state: records it as the incumbent if it is in the goal cell, otherwise
+    // expands it and routes its successors.
+    template <class Grid, class Estimate>
+    inline void expand(const Grid& grid, const Query& query, const Estimate& estimate, unsigned self)
+    {
+        worker& w = *workers[self];
+        SearchContext& context = w.context;
+        state_id current = context.pop();
+        if (context.cell_x(current) == query.goal_x && context.cell_y(current) == query.goal_y)
+        {
+            context.close(current); // it left the frontier, so later arrivals must not merge into it
+            std::lock_guard<std::mutex> lock(goal_mutex);
+            if (context.cost(current) < incumbent.load(std::memory_order_relaxed))
+            {
+                goal = current;
+                goal_pool = self;
+                incumbent.store(context.cost(current), std::memory_order_relaxed);
+            }
+            return;
+        }
+        if (!context.close(current))
+        {
+            ASTAR_STAT(context.stats.duplicate_pushes++;)
+            return;
+        }
+        context.expansions++;
+        path_node successors[20];
+        int bins[20];
+        int successor_count = AStar::generate_successors(grid, context, query, current, estimate, successors, bins);
+        for (int i = 0; i < successor_count; i++)
+        {
+            const path_node& s = successors[i];
+            message m;
+            m.position = s.position;
+            m.heading = s.heading;
+            m.previous = current;
+            m.previous_pool = std::uint16_t(self);
+            m.g = s.g;
+            m.cost = s.cost;
+            m.bin = bins[i];
+            std::size_t to = owner_of(grid.index(s.x, s.y), bins[i]);
+            if (to == self)
+            {
+                receive(grid, w, m);
+                continue;
+            }
+            message_batch*& b = w.outgoing[to];
+            if (b == nullptr)
+                b = take_batch(w);
+            b->items.push_back(m);
+            if (b->items.size() >= batch_size)
+            {
+                send(to, b);
+                b = nullptr;
+            }
+        }
+    }
+
+    template <class Grid>
+    void run(const Grid& grid, const Query& query, const heuristic& h, unsigned self)
+    {
+        worker& w = *workers[self];
+        SearchContext& context = w.context;
+        auto estimate = [&](const path_node& n) { return h.estimate(n.position, n.direction, query.goal_x, query.goal_y); };
+        bool busy = false;
+        while (!stop.load(std::memory_order_acquire))
+        {
+            if (message_batch* list = w.inbox.take_all())
+            {
+                if (!busy)
+                {
+                    work.fetch_add(1, std::memory_order_relaxed);
+                    busy = true;
+                }
+                std::int64_t received = 0;
+                while (list != nullptr)
+                {
+                    for (const message& m : list->items)
+                        receive(grid, w, m);
+                    received += std::int64_t(list->items.size());
+                    message_batch* next = list->next;
+                    list->items.clear();
+                    w.spare.push_back(list);
+                    list = next;
+                }
+                work.fetch_sub(received, std::memory_order_acq_rel);
+            }
+            if (busy)
+            {
+                bool ahead = false;
+                float limit = INFINITY;
+                for (int i = 0; i < expansions_per_poll; i++)
+                {
+                    if (context.frontier.size() == 0 || context.cost(context.frontier.front()) >= incumbent.load(std::memory_order_relaxed))
+                    {
+                        // out of work: everything generated must be sent before going idle
+                        flush(w);
+                        w.lowest.store(INFINITY, std::memory_order_relaxed);
+                        busy = false;
+                        work.fetch_sub(1, std::memory_order_acq_rel);
+                        break;
+                    }
+                    float front = context.cost(context.frontier.front());
+                    if (i == 0)
+                    {
+                        w.lowest.store(front, std::memory_order_relaxed);
+                        limit = lowest_open() + max_lead;
+                    }
+                    if (front > limit)
+                    {
+                        ahead = true;
+                        break;
+                    }
+                    expand(grid, query, estimate, self);
+                }
+                if (busy)
+                    flush(w);
+                if (ahead)
+                    std::this_thread::yield(); // let the threads behind catch up
+            }
+            else if (work.load(std::memory_order_acquire) == 0)
+            {
+                stop.store(true, std::memory_order_release);
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+};
@@ -0,0 +1,210 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "main.h"
+
+// -- PATH CACHE -- //
+
+// What a cached query is looked up by. Starts in the same cell with nearly the same heading
+// share an entry, so a hit may return a path planned from a slightly different start pose.
+// Queries from different search modes (heuristic, hierarchical, bidirectional, successors from
+// a motion table or from exact geometry) do not share, and neither do queries on different
+// maps.
+struct path_cache_key
+{
+    std::uint64_t map_id = 0; // occupancy_grid::id
+    std::uint64_t start_cell = 0;
+    std::uint64_t goal_cell = 0;
+    std::uint64_t map_version = 0;
+    float radius = 0;
+    std::uint16_t heading = 0; // start heading bin
+    std::uint16_t mode = 0;    // heuristic, routing and motion table flags
+
+    inline bool operator==(const path_cache_key& other) const
+    {
+        return map_id == other.map_id && start_cell == other.start_cell && goal_cell == other.goal_cell && map_version == other.map_version &&
+               radius == other.radius && heading == other.heading && mode == other.mode;
+    }
+};
+
+struct path_cache_key_hash
+{
+    inline std::size_t operator()(const path_cache_key& k) const
+    {
+        std::uint32_t radius_bits;
+        std::memcpy(&radius_bits, &k.radius, sizeof(radius_bits));
+        std::uint64_t h = (k.start_cell ^ k.map_id << 40) * 0x9E3779B97F4A7C15ull;
+        h = (h ^ (h >> 29) ^ k.goal_cell) * 0xBF58476D1CE4E5B9ull;
+        h = (h ^ (h >> 32) ^ k.map_version) * 0x94D049BB133111EBull;
+        h = (h ^ (h >> 29) ^ (std::uint64_t(radius_bits) << 32 | std::uint64_t(k.heading) << 16 | k.mode)) * 0x9E3779B97F4A7C15ull;
+        return std::size_t(h ^ (h >> 32));
+    }
+};
+
+// A cached answer: the planner's result without the search's own counters.
+struct cached_path
+{
+    bool found = false;
+    float cost = 0;
+    std::vector<std::size_t> path; // cell indices from goal back to start
+};
+
+struct path_cache_stats
+{
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t evictions = 0;     // entries dropped to stay within capacity
+    std::size_t invalidations = 0; // times a map's entries were dropped for a newer version of it
+    std::size_t size = 0;
+
+    inline double hit_rate() const
+    {
+        return hits + misses > 0 ? double(hits) / double(hits + misses) : 0;
+    }
+};
+
+// Bounded least-recently-used cache of planning results, safe to share between threads. Lookups
+// and inserts are a hash probe and a list splice under one mutex; results are held by
+// shared_ptr, so a hit copies the path outside the lock and eviction never invalidates a path
+// a caller still holds. The map's id and version are part of every key, and the first lookup or
+// insert for a newer version of a map drops that map's entries, so edits never serve stale
+// paths. Planners on different maps can share one cache.
+class path_cache
+{
+public:
+    explicit path_cache(std::size_t max_entries = 4096, int start_heading_bins = 64)
+        : capacity(max_entries < 1 ? 1 : max_entries), heading_bins(start_heading_bins < 1 ? 1 : start_heading_bins)
+    {
+    }
+
+    path_cache(const path_cache&) = delete;
+    path_cache& operator=(const path_cache&) = delete;
+
+    // The key of query on grid as it is now. query is the one searched: a Planner that fills in
+    // its motion tables does so before taking the key.
+    template <class Grid>
+    path_cache_key key(const Grid& grid, const Query& query) const
+    {
+        path_cache_key k;
+        k.start_cell = grid.index(int(query.start.x), int(query.start.y));
+        k.goal_cell = grid.index(query.goal_x, query.goal_y);
+        k.map_id = grid.id;
+        k.map_version = grid.version;
+        k.radius = query.radius;
+        k.heading = std::uint16_t(((std::uint32_t(encode_heading(query.direction)) * std::uint32_t(heading_bins) + 32768) >> 16) % std::uint32_t(heading_bins));
+        bool tabled = query.motions != nullptr && query.motions->radius == query.radius;
+        k.mode = std::uint16_t((query.heuristic == heuristic_mode::dubins) | (query.hierarchical << 1) | (query.bidirectional << 2) | (tabled << 3));
+        return k;
+    }
+
+    // The cached result for k, or null (a miss). Marks the entry as most recently used.
+    std::shared_ptr<const cached_path> find(const path_cache_key& k)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        retire_older(k);
+        auto it = entries.find(k);
+        if (it == entries.end())
+        {
+            misses.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        order.splice(order.begin(), order, it->second);
+        hits.fetch_add(1, std::memory_order_relaxed);
+        return it->second->second;
+    }
+
+    // Stores result under k as the most recently used entry, replacing any older one and
+    // evicting the least recently used entry when full. Results for an outdated map version
+    // are dropped.
+    void insert(const path_cache_key& k, std::shared_ptr<const cached_path> result)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!retire_older(k))
+            return;
+        auto it = entries.find(k);
+        if (it != entries.end())
+        {
+            it->second->second = std::move(result);
+            order.splice(order.begin(), order, it->second);
+            return;
+        }
+        if (entries.size() >= capacity)
+        {
+            entries.erase(order.back().first);
+            order.pop_back();
+            evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+        order.emplace_front(k, std::move(result));
+        entries.emplace(k, order.begin());
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        order.clear();
+        versions.clear();
+    }
+
+    // Counters since construction (or reset_stats); size is the current entry count.
+    path_cache_stats stats() const
+    {
+        path_cache_stats s;
+        s.hits = hits.load(std::memory_order_relaxed);
+        s.misses = misses.load(std::memory_order_relaxed);
+        s.evictions = evictions.load(std::memory_order_relaxed);
+        s.invalidations = invalidations.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(mutex);
+        s.size = entries.size();
+        return s;
+    }
+    void reset_stats()
+    {
+        hits.store(0, std::memory_order_relaxed);
+        misses.store(0, std::memory_order_relaxed);
+        evictions.store(0, std::memory_order_relaxed);
+        invalidations.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    using entry = std::pair<path_cache_key, std::shared_ptr<const cached_path>>;
+
+    const std::size_t capacity;
+    const int heading_bins;
+    mutable std::mutex mutex;
+    std::list<entry> order; // most recently used first
+    std::unordered_map<path_cache_key, std::list<entry>::iterator, path_cache_key_hash> entries;
+    std::unordered_map<std::uint64_t, std::uint64_t> versions; // newest version seen per map id, one per map ever seen
+    std::atomic<std::size_t> hits{0}, misses{0}, evictions{0}, invalidations{0};
+
+    // Drops k's map's entries when k is for a newer version of it; returns false when k is for
+    // an outdated version. Called with the lock held.
+    inline bool retire_older(const path_cache_key& k)
+    {
+        std::uint64_t& version = versions[k.map_id];
+        if (k.map_version <= version)
+            return k.map_version == version;
+        version = k.map_version;
+        std::size_t before = entries.size();
+        for (auto it = order.begin(); it != order.end();)
+        {
+            if (it->first.map_id == k.map_id)
+            {
+                entries.erase(it->first);
+                it = order.erase(it);
+            }
+            else
+                ++it;
+        }
+        if (entries.size() != before)
+            invalidations.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+};
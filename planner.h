@@ -0,0 +1,318 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include "main.h"
+#include "hierarchy.h"
+#include "bidirectional.h"
+#include "path_cache.h"
+
+struct QueryResult
+{
+    bool found = false;
+    std::vector<std::size_t> path; // cell indices from goal back to start
+    float cost = 0; // path length, valid when found
+    std::size_t expansions = 0;
+    std::size_t peak_frontier = 0;
+    search_stats stats; // zeroed unless built with ASTAR_STATS
+};
+
+// Thread-safe planning front end. The map is shared and immutable; every worker thread owns
+// its own SearchContext, so queries in a batch run concurrently without locks on the hot path.
+// Dubins tables, motion tables and cluster hierarchies are built once per radius, and the
+// distance field once per map, and shared read-only between workers.
+class Planner
+{
+public:
+    // Search with a motion_table for each query's radius unless the query brings its own.
+    // Set before planning.
+    bool motion_tables = false;
+    // Directory where motion tables are cached as files, so later runs load them instead of
+    // building them; empty keeps them in memory only. Set before planning.
+    std::string motion_cache;
+    // Answers repeated queries from this cache and stores every new answer in it; null plans
+    // every query. Queries with a search region or a footprint are always planned. May be
+    // shared with other planners, on the same map or not. Set before planning.
+    std::shared_ptr<path_cache> results;
+
+    Planner(std::shared_ptr<const occupancy_grid> map, unsigned threads = std::thread::hardware_concurrency())
+        : grid(std::move(map))
+    {
+        if (threads == 0)
+            threads = 1;
+        contexts.resize(threads);
+        backward_contexts.resize(threads);
+        for (unsigned i = 0; i < threads; i++)
+        {
+            contexts[i].reset(new SearchContext());
+            backward_contexts[i].reset(new SearchContext());
+            workers.emplace_back(&Planner::worker_loop, this, i);
+        }
+    }
+
+    ~Planner()
+    {
+        {
+            std::lock_guard<std::mutex> lock(batch_mutex);
+            stopping = true;
+        }
+        batch_ready.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    Planner(const Planner&) = delete;
+    Planner& operator=(const Planner&) = delete;
+
+    inline const occupancy_grid& map() const
+    {
+        return *grid;
+    }
+    inline unsigned thread_count() const
+    {
+        return unsigned(workers.size());
+    }
+
+    // Plans one query on the caller's thread with the caller's context. Bidirectional queries
+    // also need a context for the goal side; without one a context owned by the calling thread
+    // is used.
+    bool plan(const Query& query, QueryResult& result, SearchContext& context, SearchContext* backward = nullptr)
+    {
+        const dubins_table* table = query.heuristic == heuristic_mode::dubins ? &dubins(query.radius) : nullptr;
+        const motion_table* primitives = motion_tables && query.motions == nullptr ? &motions(query.radius) : nullptr;
+        if (query.bidirectional && backward == nullptr)
+        {
+            thread_local SearchContext caller_backward;
+            backward = &caller_backward;
+        }
+        return solve(query, result, context, backward, table, primitives);
+    }
+
+    // Plans a multi-goal query (AStar::get_paths) on the caller's thread with the caller's
+    // context: one search from query's start to the goals' cells, stopping after the
+    // max_found nearest. Returns how many goals were reached.
+    std::size_t plan_goals(const Query& original, std::span<goal_path> goals, SearchContext& context, std::size_t max_found = SIZE_MAX)
+    {
+        Query query = original;
+        if (motion_tables && query.motions == nullptr)
+            query.motions = &motions(query.radius);
+        heuristic h;
+        if (query.heuristic == heuristic_mode::dubins)
+            h = heuristic(&dubins(query.radius));
+        return AStar::get_paths(*grid, context, query, goals, max_found, h);
+    }
+
+    // Spreads the queries across the worker pool and blocks until all of them are answered.
+    // results must hold at least queries.size() entries; result i answers query i.
+    // Only one batch runs at a time; concurrent callers are serialized.
+    void plan_batch(std::span<const Query> queries, std::span<QueryResult> results)
+    {
+        std::lock_guard<std::mutex> caller_lock(caller_mutex);
+        // build every needed table up front so workers only ever read the cache
+        for (const auto& query : queries)
+        {
+            if (query.heuristic == heuristic_mode::dubins)
+                dubins(query.radius);
+            if (query.hierarchical)
+                hierarchy(query.radius);
+            if (motion_tables && query.motions == nullptr)
+                motions(query.radius);
+        }
+        std::unique_lock<std::mutex> lock(batch_mutex);
+        batch_queries = queries;
+        batch_results = results;
+        next_query.store(0);
+        busy_workers = unsigned(workers.size());
+        batch_id++;
+        batch_ready.notify_all();
+        batch_done.wait(lock, [this] { return busy_workers == 0; });
+    }
+
+    // Returns the Dubins table for radius, building it on first use.
+    const dubins_table& dubins(float radius)
+    {
+        std::lock_guard<std::mutex> lock(table_mutex);
+        auto& table = tables[radius];
+        if (!table)
+            table.reset(new dubins_table(radius));
+        return *table;
+    }
+
+    // Returns the motion table for radius, loading it from motion_cache or building (and
+    // caching) it on first use.
+    const motion_table& motions(float radius)
+    {
+        std::lock_guard<std::mutex> lock(motion_mutex);
+        auto& table = motion_tables_by_radius[radius];
+        if (!table)
+        {
+            table.reset(new motion_table());
+            if (motion_cache.empty())
+            {
+                table->build(radius);
+            }
+            else
+            {
+                char name[64];
+                std::snprintf(name, sizeof(name), "/motions_%g.ampt", radius);
+                table->load_or_build((motion_cache + name).c_str(), radius);
+            }
+        }
+        return *table;
+    }
+
+    // Returns the map's distance field for footprint checks (see collision_checker), building
+    // it on first use with all workers' worth of threads.
+    const distance_field& clearance()
+    {
+        std::lock_guard<std::mutex> lock(clearance_mutex);
+        if (!distances)
+            distances.reset(new distance_field(*grid, 2, thread_count()));
+        return *distances;
+    }
+
+    // Returns the cluster hierarchy for radius, building it on first use with all workers'
+    // worth of threads.
+    const ClusterHierarchy& hierarchy(float radius)
+    {
+        std::lock_guard<std::mutex> lock(hierarchy_mutex);
+        auto& entry = hierarchies[radius];
+        if (!entry)
+            entry.reset(new ClusterHierarchy(grid, radius, 16, thread_count()));
+        return *entry;
+    }
+
+private:
+    std::shared_ptr<const occupancy_grid> grid;
+    std::vector<std::unique_ptr<SearchContext>> contexts; // one per worker
+    std::vector<std::unique_ptr<SearchContext>> backward_contexts; // goal sides of bidirectional queries
+    std::vector<std::thread> workers;
+
+    std::mutex caller_mutex;
+    std::mutex batch_mutex;
+    std::condition_variable batch_ready;
+    std::condition_variable batch_done;
+    std::span<const Query> batch_queries;
+    std::span<QueryResult> batch_results;
+    std::atomic<std::size_t> next_query{0};
+    unsigned busy_workers = 0;
+    std::size_t batch_id = 0;
+    bool stopping = false;
+
+    std::mutex table_mutex;
+    std::map<float, std::unique_ptr<dubins_table>> tables;
+
+    std::mutex hierarchy_mutex;
+    std::map<float, std::unique_ptr<ClusterHierarchy>> hierarchies;
+
+    std::mutex motion_mutex;
+    std::map<float, std::unique_ptr<motion_table>> motion_tables_by_radius;
+
+    std::mutex clearance_mutex;
+    std::unique_ptr<distance_field> distances;
+
+    // primitives, when set, is the planner's motion table for a query that brings none.
+    inline bool solve(const Query& original, QueryResult& result, SearchContext& context, SearchContext* backward, const dubins_table* table, const motion_table* primitives)
+    {
+        if (!AStar::valid_query(*grid, original))
+        {
+            result.found = false;
+            result.path.clear();
+            result.cost = 0;
+            result.expansions = 0;
+            result.peak_frontier = 0;
+            result.stats = search_stats();
+            return false;
+        }
+        Query query = original;
+        if (primitives != nullptr && query.motions == nullptr)
+            query.motions = primitives;
+        path_cache_key key;
+        bool cacheable = results != nullptr && query.region == nullptr && query.collision == nullptr;
+        if (cacheable)
+        {
+            key = results->key(*grid, query);
+            if (std::shared_ptr<const cached_path> hit = results->find(key))
+            {
+                result.found = hit->found;
+                result.path.assign(hit->path.begin(), hit->path.end());
+                result.cost = hit->cost;
+                result.expansions = 0;
+                result.peak_frontier = 0;
+                result.stats = search_stats();
+                return result.found;
+            }
+        }
+        heuristic h;
+        if (table != nullptr)
+            h = heuristic(table);
+        if (query.hierarchical)
+            result.found = hierarchy(query.radius).get_path(context, query, result.path, h);
+        else if (query.bidirectional)
+            result.found = BidirectionalAStar::get_path(*grid, context, *backward, query, result.path, h);
+        else
+            result.found = AStar::get_path(*grid, context, query, result.path, h);
+        result.cost = context.path_cost;
+        result.expansions = context.expansions;
+        result.peak_frontier = context.peak_frontier;
+        result.stats = context.stats;
+        if (cacheable)
+        {
+            std::shared_ptr<cached_path> entry(new cached_path());
+            entry->found = result.found;
+            entry->cost = result.cost;
+            entry->path = result.path;
+            results->insert(key, std::move(entry));
+        }
+        return result.found;
+    }
+
+    void worker_loop(unsigned index)
+    {
+        SearchContext& context = *contexts[index];
+        SearchContext& backward = *backward_contexts[index];
+        std::size_t seen_batch = 0;
+        float table_radius = -1; // last tables looked up, to skip the cache locks on repeats
+        const dubins_table* table = nullptr;
+        float primitives_radius = -1;
+        const motion_table* primitives = nullptr;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(batch_mutex);
+                batch_ready.wait(lock, [&] { return stopping || batch_id != seen_batch; });
+                if (stopping)
+                    return;
+                seen_batch = batch_id;
+            }
+            // queries are claimed one at a time so long searches do not stall a whole slice
+            for (std::size_t i = next_query.fetch_add(1); i < batch_queries.size(); i = next_query.fetch_add(1))
+            {
+                const Query& query = batch_queries[i];
+                if (query.heuristic == heuristic_mode::dubins && query.radius != table_radius)
+                {
+                    table = &dubins(query.radius);
+                    table_radius = query.radius;
+                }
+                bool tabled = motion_tables && query.motions == nullptr;
+                if (tabled && query.radius != primitives_radius)
+                {
+                    primitives = &motions(query.radius);
+                    primitives_radius = query.radius;
+                }
+                solve(query, batch_results[i], context, &backward, query.heuristic == heuristic_mode::dubins ? table : nullptr, tabled ? primitives : nullptr);
+            }
+            {
+                std::lock_guard<std::mutex> lock(batch_mutex);
+                if (--busy_workers == 0)
+                    batch_done.notify_one();
+            }
+        }
+    }
+};
@@ -0,0 +1,114 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <ostream>
+#include <string>
+
+// Hot-path instrumentation. Build with -DASTAR_STATS=1 to collect the counters below; by
+// default every ASTAR_STAT(...) statement compiles to nothing and search_stats stays zeroed.
+#ifndef ASTAR_STATS
+#define ASTAR_STATS 0
+#endif
+
+#if ASTAR_STATS
+#define ASTAR_STAT(...) __VA_ARGS__
+#else
+#define ASTAR_STAT(...)
+#endif
+
+struct search_stats
+{
+    std::size_t nodes_expanded = 0;
+    std::size_t successors_generated = 0;  // crossings that passed every filter (pushed or merged)
+    std::size_t rejected_out_of_bounds = 0;
+    std::size_t rejected_obstacle = 0;
+    std::size_t rejected_backward = 0;     // crossing lies behind the agent
+    std::size_t rejected_collision = 0;    // the footprint hits an obstacle on the way (Query::collision)
+    std::size_t closed_set_hits = 0;       // successor landed in an already expanded lattice bin
+    std::size_t duplicate_pushes = 0;      // frontier entries discarded on pop as already expanded
+    std::size_t merged_successors = 0;     // successor dropped: an open state in its bin was as cheap
+    std::size_t heap_pushes = 0;
+    std::size_t heap_pops = 0;
+    std::size_t decrease_keys = 0;         // open states moved in place to a cheaper arrival
+    std::size_t reopened = 0;              // expanded bins reopened for a cheaper arrival (ParallelAStar)
+    std::size_t peak_frontier = 0;
+    std::uint64_t successor_ns = 0;        // time spent generating successors
+    std::uint64_t heap_ns = 0;             // time spent in frontier push/pop
+
+    // Adds another search's counters, e.g. the other half of a search split across contexts.
+    inline void add(const search_stats& other)
+    {
+        nodes_expanded += other.nodes_expanded;
+        successors_generated += other.successors_generated;
+        rejected_out_of_bounds += other.rejected_out_of_bounds;
+        rejected_obstacle += other.rejected_obstacle;
+        rejected_backward += other.rejected_backward;
+        rejected_collision += other.rejected_collision;
+        closed_set_hits += other.closed_set_hits;
+        duplicate_pushes += other.duplicate_pushes;
+        merged_successors += other.merged_successors;
+        heap_pushes += other.heap_pushes;
+        heap_pops += other.heap_pops;
+        decrease_keys += other.decrease_keys;
+        reopened += other.reopened;
+        peak_frontier = other.peak_frontier > peak_frontier ? other.peak_frontier : peak_frontier;
+        successor_ns += other.successor_ns;
+        heap_ns += other.heap_ns;
+    }
+
+    inline static std::uint64_t now_ns()
+    {
+        return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+};
+
+// Returns text as a quoted JSON string, escaping quotes, backslashes and control characters.
+inline std::string json_string(const std::string& text)
+{
+    static const char hex[] = "0123456789abcdef";
+    std::string out = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            out += "\\u00";
+            out += hex[(unsigned char)c >> 4];
+            out += hex[c & 15];
+        }
+        else
+            out += c;
+    }
+    return out + "\"";
+}
+
+// Writes the stats as one JSON object followed by a newline (JSON Lines). extra_fields, when
+// given, is copied verbatim at the front of the object, e.g. "\"map\":\"maze\","; build its
+// string values with json_string.
+inline void write_json_line(std::ostream& out, const search_stats& s, bool found, float cost, const char* extra_fields = "")
+{
+    out << "{" << extra_fields << "\"found\":" << (found ? "true" : "false")
+        << ",\"cost\":" << cost
+        << ",\"nodes_expanded\":" << s.nodes_expanded
+        << ",\"successors_generated\":" << s.successors_generated
+        << ",\"rejected_out_of_bounds\":" << s.rejected_out_of_bounds
+        << ",\"rejected_obstacle\":" << s.rejected_obstacle
+        << ",\"rejected_backward\":" << s.rejected_backward
+        << ",\"rejected_collision\":" << s.rejected_collision
+        << ",\"closed_set_hits\":" << s.closed_set_hits
+        << ",\"duplicate_pushes\":" << s.duplicate_pushes
+        << ",\"merged_successors\":" << s.merged_successors
+        << ",\"heap_pushes\":" << s.heap_pushes
+        << ",\"heap_pops\":" << s.heap_pops
+        << ",\"decrease_keys\":" << s.decrease_keys
+        << ",\"reopened\":" << s.reopened
+        << ",\"peak_frontier\":" << s.peak_frontier
+        << ",\"successor_ns\":" << s.successor_ns
+        << ",\"heap_ns\":" << s.heap_ns
+        << "}\n";
+}
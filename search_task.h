@@ -0,0 +1,172 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <span>
+#include <vector>
+#include "main.h"
+
+// -- TIME-SLICED SEARCH -- //
+
+enum class search_status
+{
+    idle,      // no query started
+    running,   // more steps needed
+    found,     // path() holds the result
+    no_path,   // the goal cannot be reached
+    cancelled  // cancel() was called before the search finished
+};
+
+struct search_progress
+{
+    search_status status = search_status::idle;
+    std::size_t expansions = 0;
+    std::size_t frontier = 0;
+    float estimated_cost = 0; // estimated total cost of the last state expanded (the path cost once found)
+    float closest = INFINITY; // smallest heuristic distance to the goal among expanded states
+};
+
+// AStar::get_path's loop as a resumable object, for callers that cannot block for a whole
+// query: start() sets up the search and each step() expands at most a given number of states,
+// keeping the frontier and closed set in the task's own context between calls. Many tasks can
+// share one thread, see run_frame().
+class SearchTask
+{
+public:
+    SearchTask(int heading_bins = 32, int offset_bins = 1)
+        : context(heading_bins, offset_bins)
+    {
+    }
+
+    SearchTask(const SearchTask&) = delete;
+    SearchTask& operator=(const SearchTask&) = delete;
+
+    // Starts query, dropping any search in progress. A dubins heuristic must be built for
+    // query.radius and outlive the search.
+    template <class Grid>
+    void start(const Grid& grid, const Query& query, const heuristic& h = heuristic())
+    {
+        task_query = query;
+        task_heuristic = h;
+        result.clear();
+        lowest_cost = 0;
+        closest = INFINITY;
+        cancel_requested.store(false, std::memory_order_relaxed);
+        context.reset(grid.width, grid.height);
+        if (!AStar::valid_query(grid, query))
+        {
+            current = search_status::no_path;
+            return;
+        }
+        context.push(context.add_start(query.start, query.direction, h.estimate(query.start, query.direction, query.goal_x, query.goal_y)));
+        current = search_status::running;
+    }
+
+    // Expands up to max_expansions states (pops of already expanded bins are not counted)
+    // and returns the status afterwards. grid must be the map start() was given, unchanged.
+    template <class Grid>
+    search_status step(const Grid& grid, std::size_t max_expansions)
+    {
+        if (current != search_status::running)
+            return current;
+        const int goal_x = task_query.goal_x, goal_y = task_query.goal_y;
+        const heuristic& h = task_heuristic;
+        auto estimate = [&](const path_node& n) { return h.estimate(n.position, n.direction, goal_x, goal_y); };
+        std::size_t limit = context.expansions + max_expansions;
+        while (context.expansions < limit)
+        {
+            if (cancel_requested.load(std::memory_order_relaxed))
+            {
+                current = search_status::cancelled;
+                break;
+            }
+            if (context.frontier.size() == 0)
+            {
+                current = search_status::no_path;
+                break;
+            }
+            state_id front = context.frontier.front();
+            if (context.cell_x(front) == goal_x && context.cell_y(front) == goal_y)
+            {
+                AStar::trace_path(grid, context, front, result);
+                current = search_status::found;
+                break;
+            }
+            lowest_cost = context.cost(front);
+            if (context.cost(front) - context.g(front) < closest)
+                closest = context.cost(front) - context.g(front);
+            AStar::expand(grid, context, task_query, estimate);
+        }
+        ASTAR_STAT(context.stats.nodes_expanded = context.expansions; context.stats.peak_frontier = context.peak_frontier;)
+        return current;
+    }
+
+    // Asks the search to stop; safe to call from any thread. A running task turns cancelled at
+    // its next step().
+    inline void cancel()
+    {
+        cancel_requested.store(true, std::memory_order_relaxed);
+    }
+
+    inline search_status status() const
+    {
+        return current;
+    }
+    search_progress progress() const
+    {
+        search_progress p;
+        p.status = current;
+        p.expansions = context.expansions;
+        p.frontier = context.frontier.size();
+        p.estimated_cost = current == search_status::found ? context.path_cost : lowest_cost;
+        p.closest = closest;
+        return p;
+    }
+    // Cells from goal back to start, once status() is found.
+    inline const std::vector<std::size_t>& path() const
+    {
+        return result;
+    }
+    // The search itself: path cost and pose once found, stats, visited cells.
+    inline const SearchContext& search() const
+    {
+        return context;
+    }
+
+private:
+    SearchContext context;
+    Query task_query;
+    heuristic task_heuristic;
+    search_status current = search_status::idle;
+    std::vector<std::size_t> result;
+    float lowest_cost = 0; // cost of the last state expanded
+    float closest = INFINITY;
+    std::atomic<bool> cancel_requested{false};
+};
+
+// Steps the running tasks round-robin, slice expansions at a time, until they all finish or
+// budget runs out; the clock is read once per slice. Returns how many tasks are still running.
+// Tasks must all search grid.
+template <class Grid>
+std::size_t run_frame(const Grid& grid, std::span<SearchTask* const> tasks, std::chrono::steady_clock::duration budget, std::size_t slice = 256)
+{
+    auto deadline = std::chrono::steady_clock::now() + budget;
+    std::size_t running = tasks.size();
+    while (running > 0 && std::chrono::steady_clock::now() < deadline)
+    {
+        running = 0;
+        for (SearchTask* task : tasks)
+        {
+            if (task->status() != search_status::running)
+                continue;
+            if (task->step(grid, slice) == search_status::running)
+                running++;
+            if (std::chrono::steady_clock::now() >= deadline)
+                break;
+        }
+    }
+    running = 0;
+    for (SearchTask* task : tasks)
+        running += task->status() == search_status::running;
+    return running;
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "geometry.h"
+
+// Search tracing. Build with -DASTAR_TRACE=1 and point SearchContext::trace at a search_trace
+// to record every expansion and the final path of the context's queries; by default every
+// ASTAR_TRACE_EVENT(...) statement compiles to nothing and SearchContext has no trace member.
+#ifndef ASTAR_TRACE
+#define ASTAR_TRACE 0
+#endif
+
+#if ASTAR_TRACE
+#define ASTAR_TRACE_EVENT(...) __VA_ARGS__
+#else
+#define ASTAR_TRACE_EVENT(...)
+#endif
+
+enum class trace_kind : std::uint8_t
+{
+    expanded, // a state taken off the frontier and expanded, in expansion order
+    path      // a state of the path found, from the goal back to the start
+};
+
+// One traced state: 16 bytes, written to trace files as is.
+struct trace_record
+{
+    float x = 0, y = 0;
+    float g = 0;
+    std::uint16_t heading = 0; // fixed point, see decode_heading
+    trace_kind kind = trace_kind::expanded;
+    std::uint8_t reserved = 0;
+};
+static_assert(sizeof(trace_record) == 16, "trace records are written to files as is");
+
+// Compact record of one query's search: the map size, the goal cell and the traced states in
+// order. Recording appends a record to a vector, nothing else; drawing is left to the offline
+// renderer (trace_render.h), so a traced query pays a few nanoseconds per expansion.
+class search_trace
+{
+public:
+    int width = 0, height = 0;
+    int goal_x = -1, goal_y = -1; // -1 when the query's goal is not known
+    std::vector<trace_record> records;
+
+    // Starts the trace of a new query on a width x height map; keeps the records' capacity.
+    inline void begin(int w, int h)
+    {
+        width = w;
+        height = h;
+        goal_x = goal_y = -1;
+        records.clear();
+    }
+    inline void set_goal(int x, int y)
+    {
+        goal_x = x;
+        goal_y = y;
+    }
+    inline void add(trace_kind kind, const vector2d& position, std::uint16_t heading, float g)
+    {
+        trace_record r;
+        r.x = position.x;
+        r.y = position.y;
+        r.g = g;
+        r.heading = heading;
+        r.kind = kind;
+        records.push_back(r);
+    }
+
+    // -- TRACE FILES -- //
+
+    // Writes the trace to path. Returns false if the file cannot be written.
+    bool save(const char* path) const
+    {
+        file_header header;
+        header.width = std::uint32_t(width);
+        header.height = std::uint32_t(height);
+        header.goal_x = goal_x;
+        header.goal_y = goal_y;
+        header.record_count = records.size();
+        std::FILE* out = std::fopen(path, "wb");
+        if (out == nullptr)
+            return false;
+        bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1;
+        ok = ok && std::fwrite(records.data(), sizeof(trace_record), records.size(), out) == records.size();
+        return std::fclose(out) == 0 && ok;
+    }
+
+    // Reads a trace written by save(). Returns false and leaves the trace untouched if the
+    // file is missing or malformed.
+    bool load(const char* path)
+    {
+        std::FILE* in = std::fopen(path, "rb");
+        if (in == nullptr)
+            return false;
+        file_header header;
+        bool ok = std::fread(&header, sizeof(header), 1, in) == 1 && std::memcmp(header.magic, "ATRC", 4) == 0 && header.version == 1;
+        std::vector<trace_record> read_records;
+        if (ok)
+        {
+            std::fseek(in, 0, SEEK_END);
+            long size = std::ftell(in);
+            ok = size >= 0 && (std::uint64_t(size) - sizeof(header)) / sizeof(trace_record) >= header.record_count;
+            std::fseek(in, long(sizeof(header)), SEEK_SET);
+        }
+        if (ok)
+        {
+            read_records.resize(std::size_t(header.record_count));
+            ok = std::fread(read_records.data(), sizeof(trace_record), read_records.size(), in) == read_records.size();
+        }
+        std::fclose(in);
+        if (!ok)
+            return false;
+        width = int(header.width);
+        height = int(header.height);
+        goal_x = header.goal_x;
+        goal_y = header.goal_y;
+        records.swap(read_records);
+        return true;
+    }
+
+private:
+    struct file_header
+    {
+        char magic[4] = {'A', 'T', 'R', 'C'};
+        std::uint32_t version = 1;
+        std::uint32_t width = 0;
+        std::uint32_t height = 0;
+        std::int32_t goal_x = -1;
+        std::int32_t goal_y = -1;
+        std::uint64_t record_count = 0;
+    };
+};
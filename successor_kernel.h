@@ -0,0 +1,149 @@
+#pragma once
+#include <math.h>
+#include "geometry.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ASTAR_SIMD_KERNEL 1
+#endif
+
+// Raw crossings of one expansion with the borders of the current cell: the left and right
+// turning circles (up to 2 hits per edge each) and the straight ray (up to 1 hit per edge).
+// Hits are stored edge by edge in the same order the scalar helpers used to produce them.
+struct cell_crossings
+{
+    vector2d circle[2][8];
+    int circle_count[2] = {0, 0};
+    vector2d line[4];
+    int line_count = 0;
+};
+
+// The four cell edges as structure-of-arrays lanes: p1->p2, p2->p3, p3->p4, p4->p1.
+static const float edge_dx[4] = {1, 0, -1, 0};
+static const float edge_dy[4] = {0, 1, 0, -1};
+
+#ifdef ASTAR_SIMD_KERNEL
+
+// Intersects a circle with all four edges at once, one edge per SSE lane.
+inline int circle_crossings_simd(__m128 ex, __m128 ey, __m128 dx, __m128 dy, const vector2d& center, float radius, vector2d out[8])
+{
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    __m128 fx = _mm_sub_ps(ex, _mm_set1_ps(center.x));
+    __m128 fy = _mm_sub_ps(ey, _mm_set1_ps(center.y));
+    // edges have unit length, so a = d.d = 1
+    __m128 b = _mm_mul_ps(_mm_set1_ps(2.0f), _mm_add_ps(_mm_mul_ps(fx, dx), _mm_mul_ps(fy, dy)));
+    __m128 c = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(fx, fx), _mm_mul_ps(fy, fy)), _mm_set1_ps(radius * radius));
+    __m128 disc = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(_mm_set1_ps(4.0f), c));
+    __m128 real = _mm_cmpge_ps(disc, zero);
+    disc = _mm_sqrt_ps(_mm_max_ps(disc, zero));
+    __m128 nb = _mm_sub_ps(zero, b);
+    __m128 t1 = _mm_div_ps(_mm_sub_ps(nb, disc), _mm_set1_ps(2.0f));
+    __m128 t2 = _mm_div_ps(_mm_add_ps(nb, disc), _mm_set1_ps(2.0f));
+    __m128 hit1 = _mm_and_ps(real, _mm_and_ps(_mm_cmpge_ps(t1, zero), _mm_cmple_ps(t1, one)));
+    __m128 hit2 = _mm_and_ps(_mm_and_ps(real, _mm_cmpneq_ps(disc, zero)), _mm_and_ps(_mm_cmpge_ps(t2, zero), _mm_cmple_ps(t2, one)));
+    int mask1 = _mm_movemask_ps(hit1), mask2 = _mm_movemask_ps(hit2);
+    if ((mask1 | mask2) == 0)
+        return 0;
+    alignas(16) float x1[4], y1[4], x2[4], y2[4];
+    _mm_store_ps(x1, _mm_add_ps(ex, _mm_mul_ps(dx, t1)));
+    _mm_store_ps(y1, _mm_add_ps(ey, _mm_mul_ps(dy, t1)));
+    _mm_store_ps(x2, _mm_add_ps(ex, _mm_mul_ps(dx, t2)));
+    _mm_store_ps(y2, _mm_add_ps(ey, _mm_mul_ps(dy, t2)));
+    int count = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        if (mask1 & (1 << i)) out[count++] = vector2d(x1[i], y1[i]);
+        if (mask2 & (1 << i)) out[count++] = vector2d(x2[i], y2[i]);
+    }
+    return count;
+}
+
+// Intersects the segment start -> start + s1 with all four edges at once.
+inline int line_crossings_simd(__m128 ex, __m128 ey, __m128 dx, __m128 dy, const vector2d& start, const vector2d& s1, vector2d out[4])
+{
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    __m128 s1x = _mm_set1_ps(s1.x), s1y = _mm_set1_ps(s1.y);
+    __m128 denom = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(zero, dx), s1y), _mm_mul_ps(s1x, dy));
+    __m128 rx = _mm_sub_ps(_mm_set1_ps(start.x), ex);
+    __m128 ry = _mm_sub_ps(_mm_set1_ps(start.y), ey);
+    __m128 s = _mm_div_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(zero, s1y), rx), _mm_mul_ps(s1x, ry)), denom);
+    __m128 t = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(dx, ry), _mm_mul_ps(dy, rx)), denom);
+    __m128 abs_denom = _mm_andnot_ps(_mm_set1_ps(-0.0f), denom);
+    __m128 hit = _mm_cmpge_ps(abs_denom, _mm_set1_ps(1e-6f)); // parallel or collinear otherwise
+    hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(s, zero), _mm_cmple_ps(s, one)));
+    hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(t, zero), _mm_cmple_ps(t, one)));
+    int mask = _mm_movemask_ps(hit);
+    if (mask == 0)
+        return 0;
+    alignas(16) float tt[4];
+    _mm_store_ps(tt, t);
+    int count = 0;
+    for (int i = 0; i < 4; i++)
+        if (mask & (1 << i)) out[count++] = start + s1 * tt[i];
+    return count;
+}
+
+#endif
+
+// Scalar reference for one circle against the four edges.
+inline int circle_crossings_scalar(int x, int y, const vector2d& center, float radius, vector2d out[8])
+{
+    int count = 0;
+    for (int e = 0; e < 4; e++)
+    {
+        vector2d p1(float(x + (e == 1 || e == 2)), float(y + (e >= 2)));
+        vector2d d(edge_dx[e], edge_dy[e]);
+        vector2d f = p1 - center;
+        float b = 2 * f.dot(d);
+        float c = f.dot(f) - radius * radius;
+        float disc = b * b - 4 * c;
+        if (disc < 0)
+            continue;
+        disc = sqrtf(disc);
+        float t1 = (-b - disc) / 2;
+        float t2 = (-b + disc) / 2;
+        if (t1 >= 0.0f && t1 <= 1.0f)
+            out[count++] = p1 + d * t1;
+        if (t2 >= 0.0f && t2 <= 1.0f && disc != 0.0f)
+            out[count++] = p1 + d * t2;
+    }
+    return count;
+}
+
+// Scalar reference for the segment start -> start + s1 against the four edges.
+inline int line_crossings_scalar(int x, int y, const vector2d& start, const vector2d& s1, vector2d out[4])
+{
+    int count = 0;
+    for (int e = 0; e < 4; e++)
+    {
+        vector2d p3(float(x + (e == 1 || e == 2)), float(y + (e >= 2)));
+        vector2d s2(edge_dx[e], edge_dy[e]);
+        float denom = (-s2.x * s1.y + s1.x * s2.y);
+        if (fabsf(denom) < 1e-6f)
+            continue;
+        float s = (-s1.y * (start.x - p3.x) + s1.x * (start.y - p3.y)) / denom;
+        float t = (s2.x * (start.y - p3.y) - s2.y * (start.x - p3.x)) / denom;
+        if (s >= 0.0f && s <= 1.0f && t >= 0.0f && t <= 1.0f)
+            out[count++] = start + s1 * t;
+    }
+    return count;
+}
+
+// Fused successor geometry for a state at position/direction inside cell (x, y): both turning
+// circles of the given radius and the straight ray of length line_length against the cell's
+// four edges. Everything is written into the caller's stack buffer; nothing is allocated.
+inline void cell_successor_crossings(int x, int y, const vector2d& position, const vector2d& direction, const vector2d circle_center[2], float radius, float line_length, cell_crossings& out)
+{
+    vector2d ray = (position + direction * line_length) - position; // rounded like the segment end point
+#ifdef ASTAR_SIMD_KERNEL
+    __m128 ex = _mm_add_ps(_mm_set1_ps(float(x)), _mm_setr_ps(0, 1, 1, 0));
+    __m128 ey = _mm_add_ps(_mm_set1_ps(float(y)), _mm_setr_ps(0, 0, 1, 1));
+    __m128 dx = _mm_loadu_ps(edge_dx), dy = _mm_loadu_ps(edge_dy);
+    out.circle_count[0] = circle_crossings_simd(ex, ey, dx, dy, circle_center[0], radius, out.circle[0]);
+    out.circle_count[1] = circle_crossings_simd(ex, ey, dx, dy, circle_center[1], radius, out.circle[1]);
+    out.line_count = line_crossings_simd(ex, ey, dx, dy, position, ray, out.line);
+#else
+    out.circle_count[0] = circle_crossings_scalar(x, y, circle_center[0], radius, out.circle[0]);
+    out.circle_count[1] = circle_crossings_scalar(x, y, circle_center[1], radius, out.circle[1]);
+    out.line_count = line_crossings_scalar(x, y, position, ray, out.line);
+#endif
+}
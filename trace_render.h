@@ -0,0 +1,139 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "search_trace.h"
+
+// -- TRACE RENDERING -- //
+
+// What a map cell is drawn as, in increasing precedence: a path drawn across the goal cell
+// still shows the goal, and the start shows over the rest of its path.
+enum class cell_class : std::uint8_t
+{
+    free,
+    expanded,
+    blocked,
+    path,
+    start,
+    goal
+};
+
+// A map classified cell by cell for drawing: one byte per cell, row-major. Both writers make a
+// single pass over it, so drawing costs O(width * height) however long the path or the trace.
+struct cell_image
+{
+    int width = 0, height = 0;
+    std::vector<cell_class> cells;
+
+    // Marks grid's blocked cells on an otherwise free image of the grid's size.
+    template <class Grid>
+    void assign(const Grid& grid)
+    {
+        width = grid.width;
+        height = grid.height;
+        cells.assign(std::size_t(width) * std::size_t(height), cell_class::free);
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                if (grid.blocked(x, y))
+                    cells[std::size_t(y) * width + x] = cell_class::blocked;
+    }
+
+    // Raises cell (x, y) to c unless it is already drawn as something that takes precedence.
+    inline void mark(int x, int y, cell_class c)
+    {
+        if (x < 0 || y < 0 || x >= width || y >= height)
+            return;
+        cell_class& cell = cells[std::size_t(y) * width + x];
+        if (c > cell)
+            cell = c;
+    }
+
+    // Overlays a trace: expanded cells, the path and its start, the goal.
+    void overlay(const search_trace& trace)
+    {
+        const trace_record* start = nullptr;
+        for (const trace_record& r : trace.records)
+        {
+            if (r.kind == trace_kind::expanded)
+                mark(int(r.x), int(r.y), cell_class::expanded);
+            else
+            {
+                mark(int(r.x), int(r.y), cell_class::path);
+                start = &r; // the path runs from the goal back to the start
+            }
+        }
+        if (start != nullptr)
+            mark(int(start->x), int(start->y), cell_class::start);
+        if (trace.goal_x >= 0)
+            mark(trace.goal_x, trace.goal_y, cell_class::goal);
+    }
+};
+
+// Writes the image as rows of two-character ANSI colour blocks, built in one string and
+// written at once.
+inline void write_ansi(const cell_image& image, std::ostream& out)
+{
+    static const char* const blocks[] = {
+        "\x1b[37m██\x1b[0m", // free
+        "\x1b[34m██\x1b[0m", // expanded
+        "\x1b[30m██\x1b[0m", // blocked
+        "\x1b[32m██\x1b[0m", // path
+        "\x1b[33m██\x1b[0m", // start
+        "\x1b[31m██\x1b[0m"  // goal
+    };
+    const std::size_t block_size = std::char_traits<char>::length(blocks[0]);
+    std::string text;
+    text.reserve((std::size_t(image.width) * block_size + 1) * std::size_t(image.height));
+    for (int y = 0; y < image.height; y++)
+    {
+        const cell_class* row = &image.cells[std::size_t(y) * image.width];
+        for (int x = 0; x < image.width; x++)
+            text.append(blocks[int(row[x])], block_size);
+        text += '\n';
+    }
+    out.write(text.data(), std::streamsize(text.size()));
+    out.flush();
+}
+
+// Writes the image as a binary PPM with scale x scale pixels per cell. Returns false if the
+// file cannot be written.
+inline bool write_ppm(const cell_image& image, const char* path, int scale = 1)
+{
+    static const std::uint8_t colors[][3] = {
+        {240, 240, 240}, // free
+        {90, 130, 230},  // expanded
+        {40, 40, 40},    // blocked
+        {40, 200, 70},   // path
+        {240, 200, 40},  // start
+        {220, 40, 40}    // goal
+    };
+    if (scale < 1)
+        scale = 1;
+    std::FILE* out = std::fopen(path, "wb");
+    if (out == nullptr)
+        return false;
+    std::fprintf(out, "P6\n%d %d\n255\n", image.width * scale, image.height * scale);
+    std::vector<std::uint8_t> pixels(std::size_t(image.width) * scale * 3);
+    bool ok = true;
+    for (int y = 0; y < image.height && ok; y++)
+    {
+        const cell_class* row = &image.cells[std::size_t(y) * image.width];
+        std::uint8_t* p = pixels.data();
+        for (int x = 0; x < image.width; x++)
+        {
+            const std::uint8_t* color = colors[int(row[x])];
+            for (int i = 0; i < scale; i++, p += 3)
+            {
+                p[0] = color[0];
+                p[1] = color[1];
+                p[2] = color[2];
+            }
+        }
+        for (int i = 0; i < scale && ok; i++)
+            ok = std::fwrite(pixels.data(), 1, pixels.size(), out) == pixels.size();
+    }
+    return std::fclose(out) == 0 && ok;
+}